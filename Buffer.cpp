@@ -0,0 +1,46 @@
+#include "Buffer.h"
+
+Buffer::Buffer(GLsizeiptr size, const void* data, GLbitfield flags)
+	: size(size)
+{
+	glCreateBuffers(1, &id);
+	glNamedBufferStorage(id, size, data, flags);
+}
+
+Buffer::~Buffer()
+{
+	release();
+}
+
+void Buffer::release()
+{
+	if (id != 0)
+	{
+		glDeleteBuffers(1, &id);
+		GLState::get().deleted_buffer(id);
+		id = 0;
+	}
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		id         = other.id;
+		size       = other.size;
+		other.id   = 0;
+		other.size = 0;
+	}
+	return *this;
+}
+
+void Buffer::update(GLintptr offset, GLsizeiptr length, const void* data) const
+{
+	glNamedBufferSubData(id, offset, length, data);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <utility>
+
+#include "GLState.h"
+
+
+// GPU buffer with immutable storage, created and filled without binding anything.
+// flags are glNamedBufferStorage flags: 0 for data that never changes,
+// GL_DYNAMIC_STORAGE_BIT to allow update(), GL_MAP_*_BIT to allow mapping.
+class Buffer
+{
+public:
+	Buffer() = default;
+	Buffer(GLsizeiptr size, const void* data, GLbitfield flags = 0);
+
+	// Buffer holding a whole array, e.g. Buffer vbo(vertices);
+	template <typename T, size_t N>
+	explicit Buffer(const T (&data)[N], GLbitfield flags = 0)
+		: Buffer((GLsizeiptr)sizeof(data), data, flags)
+	{
+	}
+
+	~Buffer();
+
+	Buffer(const Buffer&) = delete;
+	Buffer& operator=(const Buffer&) = delete;
+	Buffer(Buffer&& other) noexcept;
+	Buffer& operator=(Buffer&& other) noexcept;
+
+	// Overwrite part of the buffer (needs GL_DYNAMIC_STORAGE_BIT)
+	void update(GLintptr offset, GLsizeiptr length, const void* data) const;
+
+	unsigned int id = 0;
+	GLsizeiptr size = 0;
+
+	// Delete the GL object now, e.g. before the context is destroyed
+	void release();
+};
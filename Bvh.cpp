@@ -0,0 +1,672 @@
+#include "Bvh.h"
+
+#include <cmath>
+#include <future>
+#include <iostream>
+
+#include "Parallel.h"
+
+namespace
+{
+	constexpr int bin_count = 16;
+	constexpr float traversal_cost = 1.0f;     // relative to testing one object
+	constexpr uint32_t parallel_min_refs = 4096; // smaller subtrees aren't worth a thread
+	constexpr float rebuild_cost_ratio = 1.5f;
+
+	// Largest axis of a box, 0 for empty ones
+	int largest_axis(const Aabb& box)
+	{
+		const float x = box.max.x - box.min.x;
+		const float y = box.max.y - box.min.y;
+		const float z = box.max.z - box.min.z;
+		if (x >= y && x >= z)
+		{
+			return 0;
+		}
+		return y >= z ? 1 : 2;
+	}
+}
+
+Bvh::Object Bvh::insert(const Aabb& bounds)
+{
+	Object object;
+	if (!free_objects.empty())
+	{
+		object = free_objects.back();
+		free_objects.pop_back();
+		objects[object] = bounds;
+	}
+	else
+	{
+		object = (Object)objects.size();
+		objects.push_back(bounds);
+		leaf_of.push_back(free_slot);
+	}
+	leaf_of[object] = pending_slot;
+	pending.push_back(object);
+	live_count++;
+	return object;
+}
+
+void Bvh::update(Object object, const Aabb& bounds)
+{
+	const uint32_t leaf = leaf_of[object];
+	if (leaf == free_slot || leaf == removed_slot)
+	{
+		std::cout << "ERROR::BVH::UPDATE_OF_REMOVED_OBJECT\n" << object << std::endl;
+		return;
+	}
+	objects[object] = bounds;
+	if (leaf != pending_slot)
+	{
+		dirty_leaves.push_back(leaf);
+	}
+}
+
+void Bvh::remove(Object object)
+{
+	const uint32_t leaf = leaf_of[object];
+	if (leaf == free_slot || leaf == removed_slot)
+	{
+		std::cout << "ERROR::BVH::REMOVE_OF_REMOVED_OBJECT\n" << object << std::endl;
+		return;
+	}
+	objects[object] = Aabb();
+	live_count--;
+	if (leaf == pending_slot)
+	{
+		pending.erase(std::find(pending.begin(), pending.end(), object));
+		leaf_of[object] = free_slot;
+		free_objects.push_back(object);
+		return;
+	}
+	// The leaf keeps the id until the next build(), so it can't be handed out before that
+	dirty_leaves.push_back(leaf);
+	leaf_of[object] = removed_slot;
+	removed.push_back(object);
+}
+
+void Bvh::build(unsigned int threads)
+{
+	for (Object object : removed)
+	{
+		leaf_of[object] = free_slot;
+		free_objects.push_back(object);
+	}
+	removed.clear();
+	pending.clear();
+	dirty_leaves.clear();
+	nodes.clear();
+	parents.clear();
+	order.clear();
+	built_cost = 0.0f;
+
+	std::vector<BuildRef> refs;
+	refs.reserve(live_count);
+	for (Object object = 0; object < (Object)objects.size(); object++)
+	{
+		if (leaf_of[object] != free_slot)
+		{
+			refs.push_back({ objects[object], objects[object].center(), object });
+		}
+	}
+	if (refs.empty())
+	{
+		return;
+	}
+
+	// Every split below this depth hands one side to another thread
+	threads = worker_count(threads);
+	uint32_t parallel_depth = 0;
+	while ((1u << parallel_depth) < threads)
+	{
+		parallel_depth++;
+	}
+
+	nodes.reserve(2 * refs.size());
+	nodes.emplace_back();
+	build_node(nodes, 0, refs.data(), 0, (uint32_t)refs.size(), 0, parallel_depth);
+
+	order.resize(refs.size());
+	for (size_t i = 0; i < refs.size(); i++)
+	{
+		order[i] = refs[i].object;
+	}
+	parents.resize(nodes.size());
+	parents[0] = 0;
+	for (uint32_t node = 0; node < (uint32_t)nodes.size(); node++)
+	{
+		const Node& current = nodes[node];
+		if (current.count == 0)
+		{
+			parents[current.first] = node;
+			parents[current.first + 1] = node;
+			continue;
+		}
+		for (uint32_t i = current.first; i < current.first + current.count; i++)
+		{
+			leaf_of[order[i]] = node;
+		}
+	}
+	built_cost = sah_cost();
+}
+
+void Bvh::build_node(std::vector<Node>& nodes, uint32_t node, BuildRef* refs, uint32_t begin, uint32_t end,
+                     uint32_t depth, uint32_t parallel_depth)
+{
+	Aabb bounds, centroids;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bounds.grow(refs[i].bounds);
+		centroids.grow(refs[i].centroid);
+	}
+	nodes[node].bounds = bounds;
+
+	const uint32_t middle = depth < max_depth ? split(refs, begin, end, bounds, centroids) : begin;
+	if (middle == begin)
+	{
+		nodes[node].first = begin;
+		nodes[node].count = end - begin;
+		return;
+	}
+
+	const uint32_t left = (uint32_t)nodes.size();
+	nodes.emplace_back();
+	nodes.emplace_back();
+	nodes[node].first = left;
+	nodes[node].count = 0;
+
+	if (parallel_depth == 0 || end - begin < parallel_min_refs)
+	{
+		build_node(nodes, left, refs, begin, middle, depth + 1, 0);
+		build_node(nodes, left + 1, refs, middle, end, depth + 1, 0);
+		return;
+	}
+
+	// The left subtree goes into its own array on another thread and is appended afterwards,
+	// both halves only touch their own part of refs
+	std::vector<Node> left_nodes(1);
+	left_nodes.reserve(2 * (middle - begin));
+	std::future<void> worker = std::async(std::launch::async, [&]()
+	{
+		build_node(left_nodes, 0, refs, begin, middle, depth + 1, parallel_depth - 1);
+	});
+	build_node(nodes, left + 1, refs, middle, end, depth + 1, parallel_depth - 1);
+	worker.get();
+
+	// left_nodes[0] takes the reserved slot, the rest move to the end: index i becomes offset + i
+	const uint32_t offset = (uint32_t)nodes.size() - 1;
+	for (size_t i = 0; i < left_nodes.size(); i++)
+	{
+		Node moved = left_nodes[i];
+		if (moved.count == 0)
+		{
+			moved.first += offset;
+		}
+		if (i == 0)
+		{
+			nodes[left] = moved;
+		}
+		else
+		{
+			nodes.push_back(moved);
+		}
+	}
+}
+
+uint32_t Bvh::split(BuildRef* refs, uint32_t begin, uint32_t end, const Aabb& bounds, const Aabb& centroids)
+{
+	const uint32_t count = end - begin;
+	if (count <= 1)
+	{
+		return begin;
+	}
+
+	const int axis = largest_axis(centroids);
+	const float axis_min = centroids.min[axis];
+	const float extent = centroids.max[axis] - axis_min;
+	if (!(extent > 0.0f))
+	{
+		// All centers in one spot, SAH can't separate them
+		if (count <= max_leaf_size)
+		{
+			return begin;
+		}
+		return begin + count / 2;
+	}
+
+	struct Bin
+	{
+		Aabb bounds;
+		uint32_t count = 0;
+	};
+	Bin bins[bin_count];
+	const float scale = bin_count / extent;
+	auto bin_of = [&](const BuildRef& ref)
+	{
+		return std::min(bin_count - 1, (int)((ref.centroid[axis] - axis_min) * scale));
+	};
+	for (uint32_t i = begin; i < end; i++)
+	{
+		Bin& bin = bins[bin_of(refs[i])];
+		bin.bounds.grow(refs[i].bounds);
+		bin.count++;
+	}
+
+	// Cost of splitting after bin i, swept from the right then the left
+	float right_area[bin_count];
+	uint32_t right_count[bin_count];
+	Aabb right;
+	uint32_t right_total = 0;
+	for (int i = bin_count - 1; i > 0; i--)
+	{
+		right.grow(bins[i].bounds);
+		right_total += bins[i].count;
+		right_area[i] = right.surface_area();
+		right_count[i] = right_total;
+	}
+
+	// Costs are left unnormalized by the node's area, so flat and point boxes work too
+	const float area = bounds.surface_area();
+	float best_cost = std::numeric_limits<float>::infinity();
+	int best_split = 0;
+	Aabb left;
+	uint32_t left_total = 0;
+	for (int i = 1; i < bin_count; i++)
+	{
+		left.grow(bins[i - 1].bounds);
+		left_total += bins[i - 1].count;
+		if (left_total == 0 || right_count[i] == 0)
+		{
+			continue;
+		}
+		const float cost = traversal_cost * area + left.surface_area() * left_total + right_area[i] * right_count[i];
+		if (cost < best_cost)
+		{
+			best_cost = cost;
+			best_split = i;
+		}
+	}
+
+	if (count <= max_leaf_size && best_cost >= area * count)
+	{
+		return begin;
+	}
+	// The first and last bins are never empty, so there always is a split
+	BuildRef* middle = std::partition(refs + begin, refs + end,
+		[&](const BuildRef& ref) { return bin_of(ref) < best_split; });
+	return (uint32_t)(middle - refs);
+}
+
+void Bvh::refit()
+{
+	if (dirty_leaves.empty() || nodes.empty())
+	{
+		dirty_leaves.clear();
+		return;
+	}
+
+	// Past a point one pass over everything beats walking up from each leaf
+	if (dirty_leaves.size() * 8 > nodes.size())
+	{
+		refit_all();
+		dirty_leaves.clear();
+		return;
+	}
+
+	for (uint32_t leaf : dirty_leaves)
+	{
+		refit_leaf(leaf);
+		uint32_t node = leaf;
+		while (node != 0)
+		{
+			node = parents[node];
+			const Node& current = nodes[node];
+			Aabb bounds = nodes[current.first].bounds;
+			bounds.grow(nodes[current.first + 1].bounds);
+			// Nothing above changes either
+			if (bounds == current.bounds)
+			{
+				break;
+			}
+			nodes[node].bounds = bounds;
+		}
+	}
+	dirty_leaves.clear();
+}
+
+void Bvh::refit_leaf(uint32_t node)
+{
+	Node& leaf = nodes[node];
+	Aabb bounds;
+	for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++)
+	{
+		bounds.grow(objects[order[i]]);
+	}
+	leaf.bounds = bounds;
+}
+
+void Bvh::refit_all()
+{
+	// Children come after their parents, backwards every child is done before its parent
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		Node& node = nodes[i];
+		if (node.count > 0)
+		{
+			refit_leaf((uint32_t)i);
+			continue;
+		}
+		Aabb bounds = nodes[node.first].bounds;
+		bounds.grow(nodes[node.first + 1].bounds);
+		node.bounds = bounds;
+	}
+}
+
+bool Bvh::needs_rebuild() const
+{
+	const size_t built = order.size();
+	if ((pending.size() + removed.size()) * 8 > built)
+	{
+		return true;
+	}
+	return sah_cost() > built_cost * rebuild_cost_ratio;
+}
+
+float Bvh::sah_cost() const
+{
+	if (nodes.empty())
+	{
+		return 0.0f;
+	}
+	const float root_area = nodes[0].bounds.surface_area();
+	if (!(root_area > 0.0f))
+	{
+		return 0.0f;
+	}
+	float cost = 0.0f;
+	for (const Node& node : nodes)
+	{
+		const float weight = node.bounds.surface_area() / root_area;
+		cost += node.count == 0 ? traversal_cost * weight : node.count * weight;
+	}
+	return cost;
+}
+
+void Bvh::query(const Frustum& frustum, std::vector<Object>& out) const
+{
+	// Distances of the box corners nearest to and farthest along each plane's normal
+	auto classify = [&](const Aabb& box, uint32_t& planes)
+	{
+		const glm::vec3 center = box.center();
+		for (int p = 0; p < 6; p++)
+		{
+			if (!(planes & (1u << p)))
+			{
+				continue;
+			}
+			const glm::vec4& plane = frustum.planes[p];
+			const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			const float reach = std::abs(plane.x) * (box.max.x - center.x) + std::abs(plane.y) * (box.max.y - center.y) +
+			                    std::abs(plane.z) * (box.max.z - center.z);
+			if (distance + reach < 0.0f)
+			{
+				return false;
+			}
+			// Entirely inside this plane, the children needn't test it again
+			if (distance - reach >= 0.0f)
+			{
+				planes &= ~(1u << p);
+			}
+		}
+		return true;
+	};
+	auto test = [&](Object object)
+	{
+		uint32_t planes = 0x3F;
+		if (!objects[object].empty() && classify(objects[object], planes))
+		{
+			out.push_back(object);
+		}
+	};
+
+	for (Object object : pending)
+	{
+		test(object);
+	}
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	struct Entry
+	{
+		uint32_t node;
+		uint32_t planes; // planes the node isn't known to be inside of
+	};
+	Entry stack[max_depth + 2];
+	size_t top = 0;
+	stack[top++] = { 0, 0x3F };
+	while (top > 0)
+	{
+		Entry entry = stack[--top];
+		const Node& node = nodes[entry.node];
+		if (node.bounds.empty() || !classify(node.bounds, entry.planes))
+		{
+			continue;
+		}
+		if (node.count == 0)
+		{
+			stack[top++] = { node.first + 1, entry.planes };
+			stack[top++] = { node.first, entry.planes };
+			continue;
+		}
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			const Object object = order[i];
+			// Inside all planes: every (live) object of the leaf is visible
+			if (entry.planes == 0)
+			{
+				if (!objects[object].empty())
+				{
+					out.push_back(object);
+				}
+				continue;
+			}
+			test(object);
+		}
+	}
+}
+
+void Bvh::query(const Aabb& box, std::vector<Object>& out) const
+{
+	for (Object object : pending)
+	{
+		if (objects[object].overlaps(box))
+		{
+			out.push_back(object);
+		}
+	}
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[max_depth + 2];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (!node.bounds.overlaps(box))
+		{
+			continue;
+		}
+		if (node.count == 0)
+		{
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+			continue;
+		}
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			if (objects[order[i]].overlaps(box))
+			{
+				out.push_back(order[i]);
+			}
+		}
+	}
+}
+
+void Bvh::query(const glm::vec3& center, float radius, std::vector<Object>& out) const
+{
+	const float radius2 = radius * radius;
+	auto touches = [&](const Aabb& box) { return !box.empty() && box.distance2(center) <= radius2; };
+
+	for (Object object : pending)
+	{
+		if (touches(objects[object]))
+		{
+			out.push_back(object);
+		}
+	}
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[max_depth + 2];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (!touches(node.bounds))
+		{
+			continue;
+		}
+		if (node.count == 0)
+		{
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+			continue;
+		}
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			if (touches(objects[order[i]]))
+			{
+				out.push_back(order[i]);
+			}
+		}
+	}
+}
+
+Bvh::Hit Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance) const
+{
+	const Ray ray = make_ray(origin, direction);
+	return raycast(origin, direction, max_distance, [&](Object object, float limit)
+	{
+		return ray_box(ray, objects[object], limit);
+	});
+}
+
+Bvh::Hit Bvh::nearest(const glm::vec3& point, float max_distance) const
+{
+	// Squared distances throughout, the square root is taken once at the end
+	Hit hit;
+	hit.distance = max_distance * max_distance;
+	auto test = [&](Object object)
+	{
+		if (objects[object].empty())
+		{
+			return;
+		}
+		const float distance = objects[object].distance2(point);
+		if (distance < hit.distance || (hit.object == no_object && distance <= hit.distance))
+		{
+			hit.object = object;
+			hit.distance = distance;
+		}
+	};
+
+	for (Object object : pending)
+	{
+		test(object);
+	}
+	if (!nodes.empty())
+	{
+		struct Entry
+		{
+			uint32_t node;
+			float distance;
+		};
+		Entry stack[max_depth + 2];
+		size_t top = 0;
+		stack[top++] = { 0, nodes[0].bounds.distance2(point) };
+		while (top > 0)
+		{
+			const Entry entry = stack[--top];
+			if (entry.distance > hit.distance)
+			{
+				continue;
+			}
+			const Node& node = nodes[entry.node];
+			if (node.count > 0)
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					test(order[i]);
+				}
+				continue;
+			}
+			Entry near_child = { node.first, nodes[node.first].bounds.distance2(point) };
+			Entry far_child = { node.first + 1, nodes[node.first + 1].bounds.distance2(point) };
+			if (far_child.distance < near_child.distance)
+			{
+				std::swap(near_child, far_child);
+			}
+			stack[top++] = far_child;
+			stack[top++] = near_child;
+		}
+	}
+
+	if (hit.object == no_object)
+	{
+		hit.distance = std::numeric_limits<float>::infinity();
+		return hit;
+	}
+	hit.distance = std::sqrt(hit.distance);
+	return hit;
+}
+
+Bvh::Ray Bvh::make_ray(const glm::vec3& origin, const glm::vec3& direction)
+{
+	// Zero components become infinities, the slab test handles those
+	Ray ray;
+	ray.origin = origin;
+	ray.inverse_direction = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	return ray;
+}
+
+float Bvh::ray_box(const Ray& ray, const Aabb& box, float max_distance)
+{
+	float entry = 0.0f;
+	float exit = max_distance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float near_distance = (box.min[axis] - ray.origin[axis]) * ray.inverse_direction[axis];
+		float far_distance = (box.max[axis] - ray.origin[axis]) * ray.inverse_direction[axis];
+		if (near_distance > far_distance)
+		{
+			std::swap(near_distance, far_distance);
+		}
+		// Written so NaNs (origin on a slab of a parallel ray) leave the range alone
+		entry = near_distance > entry ? near_distance : entry;
+		exit = far_distance < exit ? far_distance : exit;
+	}
+	if (entry > exit || box.empty())
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+	return entry;
+}
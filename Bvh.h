@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+
+
+// Axis aligned bounding box, empty (min > max) by default
+struct Aabb
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+	// Box around a sphere (center, radius)
+	static Aabb from_sphere(const glm::vec4& sphere)
+	{
+		Aabb box;
+		box.min = glm::vec3(sphere.x - sphere.w, sphere.y - sphere.w, sphere.z - sphere.w);
+		box.max = glm::vec3(sphere.x + sphere.w, sphere.y + sphere.w, sphere.z + sphere.w);
+		return box;
+	}
+
+	bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+	void grow(const Aabb& other)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = std::min(min[axis], other.min[axis]);
+			max[axis] = std::max(max[axis], other.max[axis]);
+		}
+	}
+
+	void grow(const glm::vec3& point)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = std::min(min[axis], point[axis]);
+			max[axis] = std::max(max[axis], point[axis]);
+		}
+	}
+
+	glm::vec3 center() const
+	{
+		return glm::vec3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+	}
+
+	// 0 for empty boxes
+	float surface_area() const
+	{
+		if (empty())
+		{
+			return 0.0f;
+		}
+		const float x = max.x - min.x;
+		const float y = max.y - min.y;
+		const float z = max.z - min.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	bool overlaps(const Aabb& other) const
+	{
+		return min.x <= other.max.x && max.x >= other.min.x &&
+		       min.y <= other.max.y && max.y >= other.min.y &&
+		       min.z <= other.max.z && max.z >= other.min.z;
+	}
+
+	bool operator==(const Aabb& other) const
+	{
+		return min.x == other.min.x && min.y == other.min.y && min.z == other.min.z &&
+		       max.x == other.max.x && max.y == other.max.y && max.z == other.max.z;
+	}
+
+	// Squared distance from point to the box, 0 inside
+	float distance2(const glm::vec3& point) const
+	{
+		float result = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float outside = std::max(std::max(min[axis] - point[axis], point[axis] - max[axis]), 0.0f);
+			result += outside * outside;
+		}
+		return result;
+	}
+};
+
+// Bounding volume hierarchy over object boxes for frustum culling, ray picking and proximity
+// queries in logarithmic time.
+//
+// build() sorts all objects into a binary tree with the surface area heuristic (binned,
+// up to 4 objects per leaf); the top levels' subtrees are built on worker threads. Objects
+// that only move are handled by update() plus refit(), which grows and shrinks just the
+// boxes above the changed leaves and keeps the topology. Objects inserted since the last
+// build() are tested linearly, removed ones stay in their leaf with an empty box. Refitted
+// trees slowly get worse, needs_rebuild() says when a build() pays off again.
+//
+//	Bvh bvh;
+//	Bvh::Object rock = bvh.insert(Aabb::from_sphere(sphere));
+//	bvh.build();
+//	...
+//	bvh.update(rock, Aabb::from_sphere(moved_sphere));
+//	bvh.refit();
+//	bvh.query(Frustum::from_matrix(projection * view), visible);
+class Bvh
+{
+public:
+	using Object = uint32_t;
+	static constexpr Object no_object = ~0u;
+
+	struct Hit
+	{
+		Object object = no_object;
+		float distance = std::numeric_limits<float>::infinity();
+	};
+
+	// bounds must not be empty; the object is found by queries right away
+	Object insert(const Aabb& bounds);
+	void update(Object object, const Aabb& bounds);
+	void remove(Object object);
+	const Aabb& bounds(Object object) const { return objects[object]; }
+
+	// Objects inserted and not removed
+	size_t size() const { return live_count; }
+
+	// Rebuild the whole tree from the current boxes on up to threads threads
+	// (0 = one per hardware thread)
+	void build(unsigned int threads = 0);
+
+	// Fast path for moved objects: bring the boxes above every leaf touched by update() or
+	// remove() since the last build() or refit() up to date, the tree's shape stays the same
+	void refit();
+
+	// True once enough objects were added or removed, or refitting made the tree
+	// sufficiently worse than it was when built. Walks the whole tree, call it occasionally.
+	bool needs_rebuild() const;
+
+	// Append the objects whose box intersects the query to out
+	void query(const Frustum& frustum, std::vector<Object>& out) const;
+	void query(const Aabb& box, std::vector<Object>& out) const;
+	void query(const glm::vec3& center, float radius, std::vector<Object>& out) const;
+
+	// Closest object box hit by the ray within max_distance, direction needn't be normalized
+	// (distances are in multiples of it)
+	Hit raycast(const glm::vec3& origin, const glm::vec3& direction,
+	            float max_distance = std::numeric_limits<float>::infinity()) const;
+
+	// Same with an exact test: intersect(object, max_distance) returns the distance of the
+	// object's hit, anything >= max_distance for a miss. Only objects whose box is hit
+	// closer than the best hit so far are tested.
+	template <typename Intersect>
+	Hit raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, Intersect&& intersect) const;
+
+	// Object whose box is closest to point (0 inside it), within max_distance
+	Hit nearest(const glm::vec3& point, float max_distance = std::numeric_limits<float>::infinity()) const;
+
+	// Expected cost of a query relative to testing the root box: traversed boxes plus
+	// tested objects, weighted by the chance of reaching them (surface area heuristic)
+	float sah_cost() const;
+
+	size_t node_count() const { return nodes.size(); }
+
+private:
+	// Internal nodes have count 0 and their children at first and first + 1, leaves hold the
+	// objects order[first, first + count). Children always come after their parent.
+	struct Node
+	{
+		Aabb bounds;
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	struct BuildRef
+	{
+		Aabb bounds;
+		glm::vec3 centroid;
+		Object object;
+	};
+
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 inverse_direction;
+	};
+
+	// leaf_of values of objects that aren't in a leaf
+	static constexpr uint32_t free_slot = ~0u;
+	static constexpr uint32_t pending_slot = ~0u - 1;
+	static constexpr uint32_t removed_slot = ~0u - 2; // still in a leaf until the next build()
+
+	static constexpr uint32_t max_leaf_size = 4;
+	static constexpr uint32_t max_depth = 48; // deeper nodes become leaves, bounds the query stacks
+
+	static void build_node(std::vector<Node>& nodes, uint32_t node, BuildRef* refs, uint32_t begin, uint32_t end,
+	                       uint32_t depth, uint32_t parallel_depth);
+	static uint32_t split(BuildRef* refs, uint32_t begin, uint32_t end, const Aabb& bounds, const Aabb& centroids);
+
+	static Ray make_ray(const glm::vec3& origin, const glm::vec3& direction);
+	// Entry distance (>= 0) of the ray into box, infinity if it misses or enters past max_distance
+	static float ray_box(const Ray& ray, const Aabb& box, float max_distance);
+
+	void refit_leaf(uint32_t node);
+	void refit_all();
+
+	std::vector<Aabb> objects;       // box per object id, empty for free and removed ones
+	std::vector<uint32_t> leaf_of;   // leaf node per object id or one of the *_slot values
+	std::vector<Object> free_objects;
+	std::vector<Object> removed;     // reusable after the next build()
+	std::vector<Object> pending;     // inserted since the last build()
+	size_t live_count = 0;
+
+	std::vector<Node> nodes;         // nodes[0] is the root
+	std::vector<uint32_t> parents;   // parent per node, the root's is itself
+	std::vector<Object> order;       // leaf contents
+	std::vector<uint32_t> dirty_leaves;
+	float built_cost = 0.0f;
+};
+
+template <typename Intersect>
+Bvh::Hit Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, Intersect&& intersect) const
+{
+	Hit hit;
+	hit.distance = max_distance;
+	const Ray ray = make_ray(origin, direction);
+
+	auto test = [&](Object object)
+	{
+		if (ray_box(ray, objects[object], hit.distance) < hit.distance)
+		{
+			const float distance = intersect(object, hit.distance);
+			if (distance < hit.distance)
+			{
+				hit.object = object;
+				hit.distance = distance;
+			}
+		}
+	};
+
+	for (Object object : pending)
+	{
+		test(object);
+	}
+	if (nodes.empty())
+	{
+		return hit;
+	}
+
+	// Nearer child first, nodes entered past the best hit are dropped when popped
+	struct Entry
+	{
+		uint32_t node;
+		float distance;
+	};
+	Entry stack[max_depth + 2];
+	size_t top = 0;
+	const float root_distance = ray_box(ray, nodes[0].bounds, hit.distance);
+	if (root_distance < hit.distance)
+	{
+		stack[top++] = { 0, root_distance };
+	}
+	while (top > 0)
+	{
+		const Entry entry = stack[--top];
+		if (entry.distance >= hit.distance)
+		{
+			continue;
+		}
+		const Node& node = nodes[entry.node];
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				test(order[i]);
+			}
+			continue;
+		}
+
+		Entry near_child = { node.first, ray_box(ray, nodes[node.first].bounds, hit.distance) };
+		Entry far_child = { node.first + 1, ray_box(ray, nodes[node.first + 1].bounds, hit.distance) };
+		if (far_child.distance < near_child.distance)
+		{
+			std::swap(near_child, far_child);
+		}
+		if (far_child.distance < hit.distance)
+		{
+			stack[top++] = far_child;
+		}
+		if (near_child.distance < hit.distance)
+		{
+			stack[top++] = near_child;
+		}
+	}
+	return hit;
+}
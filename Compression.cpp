@@ -0,0 +1,190 @@
+#include "Compression.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr size_t min_match   = 4;
+	constexpr size_t max_offset  = 65535;
+	constexpr size_t hash_bits   = 16;
+
+	uint32_t read32(const uint8_t* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, 4);
+		return value;
+	}
+
+	uint32_t hash4(uint32_t value)
+	{
+		return (value * 2654435761u) >> (32 - hash_bits);
+	}
+
+	void write_length(std::vector<uint8_t>& out, size_t length)
+	{
+		while (length >= 255)
+		{
+			out.push_back(255);
+			length -= 255;
+		}
+		out.push_back((uint8_t)length);
+	}
+
+	// Sequence: token (literal length << 4 | match length - 4), extra length bytes for
+	// nibbles of 15, the literals, then a 2 byte offset and extra match length bytes.
+	// The last sequence has literals only.
+	void write_sequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_length,
+	                    size_t offset, size_t match_length)
+	{
+		const size_t match_code = match_length ? match_length - min_match : 0;
+		out.push_back((uint8_t)((literal_length < 15 ? literal_length : 15) << 4 | (match_code < 15 ? match_code : 15)));
+		if (literal_length >= 15)
+		{
+			write_length(out, literal_length - 15);
+		}
+		out.insert(out.end(), literals, literals + literal_length);
+		if (match_length == 0)
+		{
+			return;
+		}
+		out.push_back((uint8_t)(offset & 0xFF));
+		out.push_back((uint8_t)(offset >> 8));
+		if (match_code >= 15)
+		{
+			write_length(out, match_code - 15);
+		}
+	}
+
+	bool read_length(const uint8_t*& p, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte;
+		do
+		{
+			if (p >= end)
+			{
+				return false;
+			}
+			byte = *p++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+std::vector<uint8_t> compress_stream(const void* data, size_t size, size_t element_size)
+{
+	// 1. transpose bytes by element
+	std::vector<uint8_t> shuffled(size);
+	const uint8_t* input = (const uint8_t*)data;
+	const size_t elements = element_size > 1 ? size / element_size : 0;
+	size_t position = 0;
+	for (size_t byte = 0; byte < element_size && elements > 0; byte++)
+	{
+		for (size_t element = 0; element < elements; element++)
+		{
+			shuffled[position++] = input[element * element_size + byte];
+		}
+	}
+	std::memcpy(shuffled.data() + position, input + position, size - position); // tail that isn't a whole element
+
+	// 2. greedy LZ77 with a hash table of the last position per 4 byte prefix
+	std::vector<uint8_t> out;
+	out.reserve(size / 2 + 16);
+	std::vector<uint32_t> table((size_t)1 << hash_bits, ~0u);
+	const uint8_t* bytes = shuffled.data();
+	size_t anchor = 0;
+	size_t ip = 0;
+	while (ip + min_match <= size)
+	{
+		const uint32_t value = read32(bytes + ip);
+		const uint32_t hash = hash4(value);
+		const uint32_t candidate = table[hash];
+		table[hash] = (uint32_t)ip;
+
+		if (candidate == ~0u || ip - candidate > max_offset || read32(bytes + candidate) != value)
+		{
+			ip++;
+			continue;
+		}
+
+		size_t length = min_match;
+		while (ip + length < size && bytes[candidate + length] == bytes[ip + length])
+		{
+			length++;
+		}
+		write_sequence(out, bytes + anchor, ip - anchor, ip - candidate, length);
+		ip += length;
+		anchor = ip;
+	}
+	write_sequence(out, bytes + anchor, size - anchor, 0, 0);
+	return out;
+}
+
+bool decompress_stream(const void* compressed, size_t compressed_size, void* output, size_t size, size_t element_size)
+{
+	// 1. LZ77 decode into shuffled order
+	std::vector<uint8_t> shuffled(size);
+	const uint8_t* p = (const uint8_t*)compressed;
+	const uint8_t* end = p + compressed_size;
+	size_t op = 0;
+	while (p < end)
+	{
+		const uint8_t token = *p++;
+		size_t literal_length = token >> 4;
+		if (literal_length == 15 && !read_length(p, end, literal_length))
+		{
+			return false;
+		}
+		if (literal_length > (size_t)(end - p) || literal_length > size - op)
+		{
+			return false;
+		}
+		std::memcpy(shuffled.data() + op, p, literal_length);
+		p += literal_length;
+		op += literal_length;
+		if (p == end)
+		{
+			break; // last sequence
+		}
+
+		if (end - p < 2)
+		{
+			return false;
+		}
+		const size_t offset = (size_t)p[0] | (size_t)p[1] << 8;
+		p += 2;
+		size_t match_length = token & 15;
+		if (match_length == 15 && !read_length(p, end, match_length))
+		{
+			return false;
+		}
+		match_length += min_match;
+		if (offset == 0 || offset > op || match_length > size - op)
+		{
+			return false;
+		}
+		// Byte by byte, matches may overlap their own output
+		for (size_t i = 0; i < match_length; i++, op++)
+		{
+			shuffled[op] = shuffled[op - offset];
+		}
+	}
+	if (op != size)
+	{
+		return false;
+	}
+
+	// 2. undo the transpose
+	uint8_t* bytes = (uint8_t*)output;
+	const size_t elements = element_size > 1 ? size / element_size : 0;
+	size_t position = 0;
+	for (size_t byte = 0; byte < element_size && elements > 0; byte++)
+	{
+		for (size_t element = 0; element < elements; element++)
+		{
+			bytes[element * element_size + byte] = shuffled[position++];
+		}
+	}
+	std::memcpy(bytes + position, shuffled.data() + position, size - position);
+	return true;
+}
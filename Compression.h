@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Lossless compression for vertex and index streams in cooked files.
+// Bytes are first transposed per element (all first bytes of every vertex, then all second
+// bytes, ...) so the slowly changing high bytes form long runs, then packed by a small
+// LZ77 coder in the style of LZ4. Decoding is a single pass without tables, fast enough
+// to beat reading the uncompressed data from a cold disk.
+
+// element_size is the vertex stride or index size, 1 skips the transpose
+std::vector<uint8_t> compress_stream(const void* data, size_t size, size_t element_size);
+
+// Returns false if the input is corrupt or doesn't decode to exactly size bytes
+bool decompress_stream(const void* compressed, size_t compressed_size, void* output, size_t size, size_t element_size);
@@ -0,0 +1,71 @@
+#include "ComputeShader.h"
+
+ComputeShader::ComputeShader(const char* path, const ProgramCache* cache, const ShaderDefines& defines)
+{
+	ShaderSource source;
+	if (source.load(path, defines))
+	{
+		build_compute(source, cache);
+	}
+}
+
+ComputeShader::ComputeShader(const ShaderLibrary& library, const char* name, const ProgramCache* cache,
+                             const ShaderDefines& defines)
+{
+	ShaderSource source;
+	if (source.load(library, name, defines))
+	{
+		build_compute(source, cache);
+	}
+}
+
+void ComputeShader::build_compute(const ShaderSource& source, const ProgramCache* cache)
+{
+	uint64_t cache_key = 0;
+	if (cache)
+	{
+		cache_key = ProgramCache::make_key(source.pieces());
+		id = cache->load(cache_key);
+		if (id != 0)
+		{
+			load_uniforms();
+			return;
+		}
+	}
+
+	unsigned int compute = create_shader(GL_COMPUTE_SHADER, source);
+	check_compile(compute, "COMPUTE");
+
+	id = glCreateProgram();
+	glAttachShader(id, compute);
+	if (cache)
+	{
+		glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(id);
+	if (check_link(id))
+	{
+		load_uniforms();
+		if (cache)
+		{
+			cache->store(cache_key, id);
+		}
+	}
+	else
+	{
+		// id == 0 tells callers there is nothing to dispatch
+		glDeleteProgram(id);
+		id = 0;
+	}
+	glDeleteShader(compute);
+}
+
+void ComputeShader::dispatch(GLuint groups_x, GLuint groups_y, GLuint groups_z)
+{
+	if (id == 0 || groups_x == 0 || groups_y == 0 || groups_z == 0)
+	{
+		return;
+	}
+	use();
+	glDispatchCompute(groups_x, groups_y, groups_z);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstdint>
+
+#include "Shader.h"
+
+
+// Program with a single compute stage. Sources are preprocessed like Shader's
+// (#include, injected defines) and can come from files or the embedded library.
+// id is 0 if compiling or linking failed, dispatch() then does nothing.
+//
+//	ComputeShader cull(SOLUTION_DIR "/cull.comp");
+//	cull.dispatch(ComputeShader::group_count(object_count, 64));
+class ComputeShader : public Shader
+{
+public:
+	ComputeShader(const char* path, const ProgramCache* cache = nullptr, const ShaderDefines& defines = {});
+
+	// Build from sources compiled into the executable (see embed_shaders.py)
+	ComputeShader(const ShaderLibrary& library, const char* name, const ProgramCache* cache = nullptr,
+	              const ShaderDefines& defines = {});
+
+	// Use the program and run groups of the local size declared in the shader.
+	// Results written to buffers/images need a glMemoryBarrier before they are read.
+	void dispatch(GLuint groups_x, GLuint groups_y = 1, GLuint groups_z = 1);
+
+	// Groups of group_size invocations needed to cover count items
+	static GLuint group_count(uint32_t count, uint32_t group_size)
+	{
+		return (GLuint)((count + group_size - 1) / group_size);
+	}
+
+private:
+	void build_compute(const ShaderSource& source, const ProgramCache* cache);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+
+// Six clip planes of a view projection matrix, normalized with the inside positive, so
+// dot(plane.xyz, p) + plane.w is the signed distance of p. Order: left, right, bottom, top,
+// near, far.
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	// Gribb/Hartmann: the planes are sums/differences of the matrix rows
+	static Frustum from_matrix(const glm::mat4& view_projection)
+	{
+		Frustum frustum;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				const float sign = side == 0 ? 1.0f : -1.0f;
+				glm::vec4 plane;
+				for (int column = 0; column < 4; column++)
+				{
+					plane[column] = view_projection[column][3] + sign * view_projection[column][axis];
+				}
+				const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+				if (length > 0.0f)
+				{
+					for (int component = 0; component < 4; component++)
+					{
+						plane[component] /= length;
+					}
+				}
+				frustum.planes[axis * 2 + side] = plane;
+			}
+		}
+		return frustum;
+	}
+
+	// sphere is center and radius, touching counts as inside
+	bool intersects(const glm::vec4& sphere) const
+	{
+		for (const glm::vec4& plane : planes)
+		{
+			if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w < -sphere.w)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,320 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#include "Parallel.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FRUSTUM_CULLING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics anywhere, they are only called after the CPU check
+#define FRUSTUM_CULLING_AVX2
+#else
+#define FRUSTUM_CULLING_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	constexpr size_t alignment = 32;
+	constexpr size_t chunk_size = 16384; // spheres per parallel task, multiple of 8
+	const float hidden_radius = -std::numeric_limits<float>::infinity();
+
+	// Branchless append of the visible lanes of mask, writes one past the last visible
+	// index so out needs a spare element inside the chunk
+	inline size_t append_lanes(uint32_t* out, size_t written, uint32_t first_index, uint32_t mask, int lanes)
+	{
+		for (int lane = 0; lane < lanes; lane++)
+		{
+			out[written] = first_index + (uint32_t)lane;
+			written += (mask >> lane) & 1;
+		}
+		return written;
+	}
+
+#ifndef FRUSTUM_CULLING_X86
+	size_t cull_scalar(const SphereBounds& bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* out)
+	{
+		const float* x = bounds.center_x();
+		const float* y = bounds.center_y();
+		const float* z = bounds.center_z();
+		const float* r = bounds.radius();
+		size_t written = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			const bool inside = frustum.intersects(glm::vec4(x[i], y[i], z[i], r[i]));
+			written = append_lanes(out, written, (uint32_t)i, inside ? 1u : 0u, 1);
+		}
+		return written;
+	}
+#endif
+
+#ifdef FRUSTUM_CULLING_X86
+	// Permutation moving the set lanes of an 8 bit mask to the front, 4 bits per lane
+	struct CompressTable
+	{
+		uint32_t lanes[256];
+		uint8_t counts[256];
+	};
+
+	constexpr CompressTable make_compress_table()
+	{
+		CompressTable table{};
+		for (uint32_t mask = 0; mask < 256; mask++)
+		{
+			uint32_t count = 0;
+			uint32_t lanes = 0;
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				if (mask & (1u << lane))
+				{
+					lanes |= lane << (count * 4);
+					count++;
+				}
+			}
+			table.lanes[mask] = lanes;
+			table.counts[mask] = (uint8_t)count;
+		}
+		return table;
+	}
+
+	constexpr CompressTable compress_table = make_compress_table();
+
+	// 4 spheres per step, a sphere is visible while it is not entirely behind any plane
+	size_t cull_sse(const SphereBounds& bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* out)
+	{
+		__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; p++)
+		{
+			plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+			plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+			plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+			plane_w[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		size_t written = 0;
+		for (size_t i = begin; i < end; i += 4)
+		{
+			const __m128 x = _mm_load_ps(bounds.center_x() + i);
+			const __m128 y = _mm_load_ps(bounds.center_y() + i);
+			const __m128 z = _mm_load_ps(bounds.center_z() + i);
+			const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_load_ps(bounds.radius() + i));
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, plane_x[p]), _mm_mul_ps(y, plane_y[p])),
+				                                   _mm_add_ps(_mm_mul_ps(z, plane_z[p]), plane_w[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+			}
+			written = append_lanes(out, written, (uint32_t)i, (uint32_t)_mm_movemask_ps(inside), 4);
+		}
+		return written;
+	}
+
+	// 8 spheres per step, visible indices are compacted with one permute and one store
+	FRUSTUM_CULLING_AVX2 size_t cull_avx2(const SphereBounds& bounds, const Frustum& frustum, size_t begin, size_t end,
+	                                      uint32_t* out)
+	{
+		__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; p++)
+		{
+			plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+			plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+			plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+			plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+		const __m256i lane_shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+		const __m256i lane_mask = _mm256_set1_epi32(0xF);
+		const __m256i step = _mm256_set1_epi32(8);
+		__m256i indices = _mm256_add_epi32(_mm256_set1_epi32((int)begin), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+		size_t written = 0;
+		for (size_t i = begin; i < end; i += 8)
+		{
+			const __m256 x = _mm256_load_ps(bounds.center_x() + i);
+			const __m256 y = _mm256_load_ps(bounds.center_y() + i);
+			const __m256 z = _mm256_load_ps(bounds.center_z() + i);
+			const __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_load_ps(bounds.radius() + i));
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				const __m256 distance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(x, plane_x[p]), _mm256_mul_ps(y, plane_y[p])),
+					_mm256_add_ps(_mm256_mul_ps(z, plane_z[p]), plane_w[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+			}
+
+			// Writes all 8 lanes, the ones past the visible count are overwritten by the next step
+			const uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+			const __m256i permutation = _mm256_and_si256(
+				_mm256_srlv_epi32(_mm256_set1_epi32((int)compress_table.lanes[mask]), lane_shifts), lane_mask);
+			_mm256_storeu_si256((__m256i*)(out + written), _mm256_permutevar8x32_epi32(indices, permutation));
+			written += compress_table.counts[mask];
+			indices = _mm256_add_epi32(indices, step);
+		}
+		return written;
+	}
+
+	bool cpu_has_avx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		// The OS has to save the AVX registers too
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	// Cull [begin, end) (multiples of 8) into out, returns the number of visible spheres.
+	// out has room for end - begin indices.
+	size_t cull_range(const SphereBounds& bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* out)
+	{
+#ifdef FRUSTUM_CULLING_X86
+		static const bool avx2 = cpu_has_avx2();
+		if (avx2)
+		{
+			return cull_avx2(bounds, frustum, begin, end, out);
+		}
+		return cull_sse(bounds, frustum, begin, end, out);
+#else
+		return cull_scalar(bounds, frustum, begin, end, out);
+#endif
+	}
+}
+
+SphereBounds::~SphereBounds()
+{
+	if (data)
+	{
+		::operator delete(data, std::align_val_t(alignment));
+	}
+}
+
+void SphereBounds::reserve(size_t reserved)
+{
+	if (reserved > capacity)
+	{
+		grow(reserved);
+	}
+}
+
+void SphereBounds::grow(size_t minimum)
+{
+	size_t new_capacity = std::max<size_t>(capacity * 2, 64);
+	while (new_capacity < minimum)
+	{
+		new_capacity *= 2;
+	}
+
+	float* new_data = static_cast<float*>(::operator new(new_capacity * 4 * sizeof(float), std::align_val_t(alignment)));
+	std::fill(new_data, new_data + new_capacity * 3, 0.0f);
+	std::fill(new_data + new_capacity * 3, new_data + new_capacity * 4, hidden_radius);
+	if (data)
+	{
+		for (size_t component = 0; component < 4; component++)
+		{
+			std::memcpy(new_data + component * new_capacity, data + component * capacity, count * sizeof(float));
+		}
+		::operator delete(data, std::align_val_t(alignment));
+	}
+	data = new_data;
+	capacity = new_capacity;
+}
+
+uint32_t SphereBounds::add(const glm::vec4& sphere)
+{
+	if (count == capacity)
+	{
+		grow(count + 1);
+	}
+	const uint32_t index = (uint32_t)count++;
+	set(index, sphere);
+	return index;
+}
+
+void SphereBounds::set(uint32_t index, const glm::vec4& sphere)
+{
+	data[index]                = sphere.x;
+	data[capacity + index]     = sphere.y;
+	data[capacity * 2 + index] = sphere.z;
+	data[capacity * 3 + index] = sphere.w;
+}
+
+void SphereBounds::hide(uint32_t index)
+{
+	data[capacity * 3 + index] = hidden_radius;
+}
+
+glm::vec4 SphereBounds::get(uint32_t index) const
+{
+	return glm::vec4(data[index], data[capacity + index], data[capacity * 2 + index], data[capacity * 3 + index]);
+}
+
+void SphereBounds::clear()
+{
+	// Padding lanes have to stay hidden for the next add()
+	if (data)
+	{
+		std::fill(data + capacity * 3, data + capacity * 3 + padded_size(), hidden_radius);
+	}
+	count = 0;
+}
+
+size_t cull_spheres(const SphereBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, unsigned int threads)
+{
+	const size_t padded = bounds.padded_size();
+	if (padded == 0)
+	{
+		return 0;
+	}
+	// Every chunk compacts into its own part of visible, never shrunk so the next frame doesn't refill it
+	if (visible.size() < padded)
+	{
+		visible.resize(padded);
+	}
+
+	const size_t chunk_count = (padded + chunk_size - 1) / chunk_size;
+	std::vector<size_t> chunk_visible(chunk_count);
+	// Called every frame, the pool's threads are started once instead of per call
+	static WorkerPool pool;
+	pool.parallel_for(chunk_count, worker_count(threads), 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			const size_t begin = chunk * chunk_size;
+			const size_t end = std::min(padded, begin + chunk_size);
+			chunk_visible[chunk] = cull_range(bounds, frustum, begin, end, visible.data() + begin);
+		}
+	});
+
+	// Close the gaps between the chunks' results
+	size_t total = chunk_visible[0];
+	for (size_t chunk = 1; chunk < chunk_count; chunk++)
+	{
+		std::memmove(visible.data() + total, visible.data() + chunk * chunk_size, chunk_visible[chunk] * sizeof(uint32_t));
+		total += chunk_visible[chunk];
+	}
+	return total;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+
+
+// Bounding spheres stored as structure of arrays: center x, y, z and radius each in their
+// own 32 byte aligned array, so the culler loads 4 or 8 objects per SIMD register.
+// Arrays are padded to a multiple of 8 with spheres that are never visible.
+class SphereBounds
+{
+public:
+	SphereBounds() = default;
+	~SphereBounds();
+
+	SphereBounds(const SphereBounds&) = delete;
+	SphereBounds& operator=(const SphereBounds&) = delete;
+
+	void reserve(size_t count);
+
+	// Returns the index of the new sphere (center, radius)
+	uint32_t add(const glm::vec4& sphere);
+	void set(uint32_t index, const glm::vec4& sphere);
+	glm::vec4 get(uint32_t index) const;
+
+	// Never visible until set() again, e.g. for removed objects (radius becomes -infinity)
+	void hide(uint32_t index);
+	void clear();
+
+	size_t size() const { return count; }
+
+	// Component arrays, valid for padded_size() elements
+	const float* center_x() const { return data; }
+	const float* center_y() const { return data + capacity; }
+	const float* center_z() const { return data + capacity * 2; }
+	const float* radius() const { return data + capacity * 3; }
+	size_t padded_size() const { return (count + 7) & ~(size_t)7; }
+
+private:
+	void grow(size_t minimum);
+
+	float* data = nullptr; // x, y, z and radius arrays of capacity floats each
+	size_t capacity = 0;   // multiple of 8
+	size_t count = 0;
+};
+
+// Write the indices of the spheres that intersect the frustum to the front of visible, in
+// increasing order, and return how many there are. visible is grown to padded_size() but
+// never shrunk, so reusing it every frame doesn't allocate or clear anything.
+// Uses AVX2 (8 spheres per instruction) when the CPU has it, SSE2 (4) otherwise, and splits
+// large sets into chunks culled on up to threads threads (0 = one per hardware thread).
+// The threads come from a WorkerPool started on the first call and kept for the next ones.
+size_t cull_spheres(const SphereBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible,
+                  unsigned int threads = 0);
@@ -0,0 +1,218 @@
+#include "GLState.h"
+
+#include <cstring>
+
+GLState& GLState::get()
+{
+	static GLState state;
+	return state;
+}
+
+template <typename T>
+bool GLState::update(Cached<T>& cached, T value)
+{
+	if (cached.known && cached.value == value)
+	{
+		current_frame.filtered++;
+		return false;
+	}
+	cached.value = value;
+	cached.known = true;
+	current_frame.issued++;
+	return true;
+}
+
+GLState::Cached<unsigned int>& GLState::buffer_slot(GLenum target)
+{
+	for (BufferBinding& binding : buffers)
+	{
+		if (binding.target == target)
+		{
+			return binding.buffer;
+		}
+	}
+	buffers.push_back({ target, {} });
+	return buffers.back().buffer;
+}
+
+GLState::Cached<unsigned int>& GLState::indexed_slot(GLenum target, unsigned int index)
+{
+	for (IndexedBinding& binding : indexed_buffers)
+	{
+		if (binding.target == target && binding.index == index)
+		{
+			return binding.buffer;
+		}
+	}
+	indexed_buffers.push_back({ target, index, {} });
+	return indexed_buffers.back().buffer;
+}
+
+void GLState::use_program(unsigned int id)
+{
+	if (update(program, id))
+	{
+		glUseProgram(id);
+	}
+}
+
+void GLState::bind_vertex_array(unsigned int vao)
+{
+	if (update(vertex_array, vao))
+	{
+		glBindVertexArray(vao);
+	}
+}
+
+void GLState::bind_buffer(GLenum target, unsigned int buffer)
+{
+	// The element buffer binding belongs to the bound VAO, so it can't be shadowed globally
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		current_frame.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (update(buffer_slot(target), buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLState::bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer)
+{
+	if (update(indexed_slot(target, index), buffer))
+	{
+		glBindBufferBase(target, index, buffer);
+
+		// Also binds the generic binding point
+		Cached<unsigned int>& generic = buffer_slot(target);
+		generic.value = buffer;
+		generic.known = true;
+	}
+}
+
+void GLState::set_capability(Cached<bool>& cached, GLenum capability, bool enabled)
+{
+	if (update(cached, enabled))
+	{
+		if (enabled)
+		{
+			glEnable(capability);
+		}
+		else
+		{
+			glDisable(capability);
+		}
+	}
+}
+
+void GLState::set_blend(bool enabled)
+{
+	set_capability(blend, GL_BLEND, enabled);
+}
+
+void GLState::blend_func(GLenum source, GLenum destination)
+{
+	if (update(blend_function, ((uint64_t)source << 32) | destination))
+	{
+		glBlendFunc(source, destination);
+	}
+}
+
+void GLState::set_depth_test(bool enabled)
+{
+	set_capability(depth_test, GL_DEPTH_TEST, enabled);
+}
+
+void GLState::depth_func(GLenum func)
+{
+	if (update(depth_function, func))
+	{
+		glDepthFunc(func);
+	}
+}
+
+void GLState::depth_mask(bool write)
+{
+	if (update(depth_write, write))
+	{
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLState::clear_color(float r, float g, float b, float a)
+{
+	// Compare bit patterns, NaN never equals itself
+	uint32_t bits[4];
+	const float color[4] = { r, g, b, a };
+	memcpy(bits, color, sizeof(bits));
+
+	const uint64_t rg = ((uint64_t)bits[0] << 32) | bits[1];
+	const uint64_t ba = ((uint64_t)bits[2] << 32) | bits[3];
+	const bool same = clear_rg.known && clear_ba.known && clear_rg.value == rg && clear_ba.value == ba;
+	if (same)
+	{
+		current_frame.filtered++;
+		return;
+	}
+	clear_rg = { rg, true };
+	clear_ba = { ba, true };
+	current_frame.issued++;
+	glClearColor(r, g, b, a);
+}
+
+void GLState::deleted_program(unsigned int id)
+{
+	if (program.value == id)
+	{
+		program.known = false;
+	}
+}
+
+void GLState::deleted_vertex_array(unsigned int vao)
+{
+	if (vertex_array.value == vao)
+	{
+		vertex_array.known = false;
+	}
+}
+
+void GLState::deleted_buffer(unsigned int buffer)
+{
+	for (BufferBinding& binding : buffers)
+	{
+		if (binding.buffer.value == buffer)
+		{
+			binding.buffer.known = false;
+		}
+	}
+	for (IndexedBinding& binding : indexed_buffers)
+	{
+		if (binding.buffer.value == buffer)
+		{
+			binding.buffer.known = false;
+		}
+	}
+}
+
+void GLState::invalidate()
+{
+	program.known        = false;
+	vertex_array.known   = false;
+	buffers.clear();
+	indexed_buffers.clear();
+	blend.known          = false;
+	blend_function.known = false;
+	depth_test.known     = false;
+	depth_function.known = false;
+	depth_write.known    = false;
+	clear_rg.known       = false;
+	clear_ba.known       = false;
+}
+
+void GLState::end_frame()
+{
+	last_frame    = current_frame;
+	current_frame = Stats();
+}
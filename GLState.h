@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstdint>
+#include <vector>
+
+
+// Shadow copy of the GL state the renderer touches. Calls that would set a value
+// that is already current are dropped before they reach the driver.
+// Anything that changes this state without going through here must call invalidate().
+class GLState
+{
+public:
+	// Counts for one frame
+	struct Stats
+	{
+		uint32_t issued   = 0; // calls passed on to GL
+		uint32_t filtered = 0; // redundant calls dropped
+	};
+
+	// State of the current context
+	static GLState& get();
+
+	void use_program(unsigned int program);
+	void bind_vertex_array(unsigned int vao);
+	void bind_buffer(GLenum target, unsigned int buffer);
+	void bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer);
+
+	void set_blend(bool enabled);
+	void blend_func(GLenum source, GLenum destination);
+	void set_depth_test(bool enabled);
+	void depth_func(GLenum func);
+	void depth_mask(bool write);
+	void clear_color(float r, float g, float b, float a);
+
+	// Deleting an object unbinds it and frees its name for reuse, forget it here too
+	void deleted_program(unsigned int program);
+	void deleted_vertex_array(unsigned int vao);
+	void deleted_buffer(unsigned int buffer);
+
+	// Forget all shadowed state, the next call of each kind is always issued
+	void invalidate();
+
+	// Close the current frame's counts (call once per frame)
+	void end_frame();
+	// Counts of the last completed frame
+	const Stats& frame_stats() const { return last_frame; }
+
+private:
+	template <typename T>
+	struct Cached
+	{
+		T value{};
+		bool known = false;
+	};
+
+	struct BufferBinding
+	{
+		GLenum target;
+		Cached<unsigned int> buffer;
+	};
+
+	struct IndexedBinding
+	{
+		GLenum target;
+		unsigned int index;
+		Cached<unsigned int> buffer;
+	};
+
+	Cached<unsigned int> program;
+	Cached<unsigned int> vertex_array;
+	std::vector<BufferBinding> buffers;
+	std::vector<IndexedBinding> indexed_buffers;
+	Cached<bool> blend;
+	Cached<uint64_t> blend_function; // source << 32 | destination
+	Cached<bool> depth_test;
+	Cached<GLenum> depth_function;
+	Cached<bool> depth_write;
+	Cached<uint64_t> clear_rg;       // clear color bit patterns, r|g and b|a
+	Cached<uint64_t> clear_ba;
+
+	Stats current_frame;
+	Stats last_frame;
+
+	// Store value, returns true if it changed and the call has to be issued
+	template <typename T>
+	bool update(Cached<T>& cached, T value);
+
+	Cached<unsigned int>& buffer_slot(GLenum target);
+	Cached<unsigned int>& indexed_slot(GLenum target, unsigned int index);
+	void set_capability(Cached<bool>& cached, GLenum capability, bool enabled);
+};
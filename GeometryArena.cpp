@@ -0,0 +1,190 @@
+#include "GeometryArena.h"
+
+GeometryArena::GeometryArena(GLsizei vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity, GLenum index_type)
+	: vertices((GLsizeiptr)vertex_stride * vertex_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT),
+	  indices((index_type == GL_UNSIGNED_SHORT ? 2 : 4) * (GLsizeiptr)index_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT),
+	  stride(vertex_stride),
+	  element_type(index_type == GL_UNSIGNED_SHORT ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT),
+	  element_size(index_type == GL_UNSIGNED_SHORT ? 2 : 4),
+	  vertex_ranges(vertex_capacity),
+	  index_ranges(index_capacity)
+{
+	vao.element_buffer(indices);
+}
+
+GeometryArena::Mesh GeometryArena::add(const void* vertex_data, uint32_t vertex_count,
+                                       const uint32_t* index_data, uint32_t index_count)
+{
+	if (vertex_count == 0 || index_count == 0)
+	{
+		std::cout << "ERROR::GEOMETRY_ARENA::EMPTY_MESH (" << vertex_count << " vertices, "
+		          << index_count << " indices)" << std::endl;
+		counters.failed_adds++;
+		return no_mesh;
+	}
+	if (element_type == GL_UNSIGNED_SHORT && vertex_count > 0x10000)
+	{
+		std::cout << "ERROR::GEOMETRY_ARENA::TOO_MANY_VERTICES_FOR_16_BIT_INDICES (" << vertex_count << ")" << std::endl;
+		counters.failed_adds++;
+		return no_mesh;
+	}
+
+	Mesh mesh;
+	if (!free_records.empty())
+	{
+		mesh = free_records.back();
+		free_records.pop_back();
+	}
+	else
+	{
+		mesh = (Mesh)records.size();
+		records.push_back(Record());
+	}
+
+	Record& record  = records[mesh];
+	record.vertices = vertex_ranges.allocate(vertex_count, mesh);
+	record.indices  = index_ranges.allocate(index_count, mesh);
+	if (!record.vertices.valid() || !record.indices.valid())
+	{
+		std::cout << "ERROR::GEOMETRY_ARENA::OUT_OF_SPACE (" << vertex_count << " vertices, "
+		          << index_count << " indices)" << std::endl;
+		vertex_ranges.free(record.vertices);
+		index_ranges.free(record.indices);
+		record = Record();
+		free_records.push_back(mesh);
+		counters.failed_adds++;
+		return no_mesh;
+	}
+	record.alive = true;
+
+	vertices.update((GLintptr)record.vertices.offset * stride, (GLsizeiptr)vertex_count * stride, vertex_data);
+	if (element_type == GL_UNSIGNED_SHORT)
+	{
+		std::vector<uint16_t> narrow(index_data, index_data + index_count);
+		indices.update((GLintptr)record.indices.offset * element_size, (GLsizeiptr)index_count * element_size, narrow.data());
+	}
+	else
+	{
+		indices.update((GLintptr)record.indices.offset * element_size, (GLsizeiptr)index_count * element_size, index_data);
+	}
+	return mesh;
+}
+
+void GeometryArena::remove(Mesh mesh)
+{
+	if (!valid(mesh))
+	{
+		return;
+	}
+	vertex_ranges.free(records[mesh].vertices);
+	index_ranges.free(records[mesh].indices);
+	records[mesh] = Record();
+	free_records.push_back(mesh);
+}
+
+GeometryArena::DrawRange GeometryArena::range(Mesh mesh) const
+{
+	if (!valid(mesh))
+	{
+		return DrawRange();
+	}
+	const Record& record = records[mesh];
+	return DrawRange{ (GLsizei)record.indices.size, record.indices.offset, (GLint)record.vertices.offset };
+}
+
+void GeometryArena::draw(Mesh mesh) const
+{
+	const DrawRange draw_range = range(mesh);
+	if (draw_range.index_count == 0)
+	{
+		return;
+	}
+	vao.bind();
+	glDrawElementsBaseVertex(GL_TRIANGLES, draw_range.index_count, element_type,
+	                         (const void*)((uintptr_t)draw_range.first_index * element_size), draw_range.base_vertex);
+}
+
+GLsizeiptr GeometryArena::defragment(GLsizeiptr max_bytes)
+{
+	if (max_bytes <= 0)
+	{
+		return 0;
+	}
+
+	// Stop before a move that would go over max_bytes. The first move is always allowed,
+	// otherwise a mesh larger than the budget would never move.
+	GLsizeiptr moved = 0;
+	bool first_move = true;
+	bool vertices_done = false;
+	bool indices_done  = false;
+	auto budget = [&]() { return first_move ? -1 : std::max<GLsizeiptr>(0, max_bytes - moved); };
+	while (!(vertices_done && indices_done) && moved < max_bytes)
+	{
+		if (!vertices_done)
+		{
+			const GLsizeiptr bytes = move_down(vertex_ranges, vertices, stride, true, budget());
+			if (bytes < 0)
+			{
+				break;
+			}
+			vertices_done = bytes == 0;
+			first_move = first_move && bytes == 0;
+			moved += bytes;
+		}
+		if (!indices_done && moved < max_bytes)
+		{
+			const GLsizeiptr bytes = move_down(index_ranges, indices, element_size, false, budget());
+			if (bytes < 0)
+			{
+				break;
+			}
+			indices_done = bytes == 0;
+			first_move = first_move && bytes == 0;
+			moved += bytes;
+		}
+	}
+	return moved;
+}
+
+GLsizeiptr GeometryArena::move_down(RangeAllocator& ranges, const Buffer& buffer, GLsizeiptr element_size, bool vertex_buffer,
+                                     GLsizeiptr budget)
+{
+	const RangeAllocator::Range last = ranges.last_allocation();
+	if (!last.valid())
+	{
+		return 0;
+	}
+	if (budget >= 0 && (GLsizeiptr)last.size * element_size > budget)
+	{
+		return -1;
+	}
+
+	// A fresh allocation only helps if it lands below the current one. It comes from
+	// free space, so source and destination never overlap as glCopyBufferSubData requires.
+	const RangeAllocator::Range target = ranges.allocate(last.size, last.owner);
+	if (!target.valid() || target.offset > last.offset)
+	{
+		ranges.free(target);
+		return 0;
+	}
+
+	// The copy is ordered with the draws in the command stream, no need to wait for the GPU
+	const GLsizeiptr bytes = (GLsizeiptr)last.size * element_size;
+	glCopyNamedBufferSubData(buffer.id, buffer.id, (GLintptr)last.offset * element_size,
+	                         (GLintptr)target.offset * element_size, bytes);
+	ranges.free(last);
+
+	Record& record = records[last.owner];
+	(vertex_buffer ? record.vertices : record.indices) = target;
+
+	counters.moved_bytes += bytes;
+	counters.moved_meshes++;
+	return bytes;
+}
+
+void GeometryArena::release()
+{
+	vao.release();
+	vertices.release();
+	indices.release();
+}
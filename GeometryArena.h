@@ -0,0 +1,129 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Buffer.h"
+#include "GLState.h"
+#include "RangeAllocator.h"
+#include "VertexArray.h"
+
+
+// All static meshes of one vertex format packed into a single vertex buffer and a single
+// index buffer, drawn from one VAO with base vertex/first index offsets. Switching meshes
+// changes no GL state at all, which is what later batching (instancing, indirect draws) needs.
+//
+// Ranges come from a RangeAllocator per buffer. Removing meshes leaves holes, defragment()
+// slides the highest meshes down into them with GPU side copies, a few bytes per frame, so
+// the free space stays in one piece at the end of the buffers.
+//
+//	GeometryArena arena = GeometryArena::create<ColorVertex>(1 << 20, 3 << 20);
+//	GeometryArena::Mesh cube = arena.add(cube_vertices, 24, cube_indices, 36);
+//	arena.draw(cube);
+//	arena.defragment(256 * 1024); // once per frame
+class GeometryArena
+{
+public:
+	using Mesh = uint32_t;
+	static constexpr Mesh no_mesh = ~0u;
+
+	// Arguments of glDrawElementsBaseVertex, offsets counted in elements
+	struct DrawRange
+	{
+		GLsizei index_count = 0;
+		GLuint first_index  = 0;
+		GLint base_vertex   = 0;
+	};
+
+	struct Stats
+	{
+		uint64_t moved_bytes = 0;  // total copied by defragment()
+		uint64_t moved_meshes = 0;
+		uint64_t failed_adds = 0;  // add() calls that didn't fit
+	};
+
+	// Capacities in vertices and indices, the buffers never grow.
+	// With GL_UNSIGNED_SHORT indices each mesh is limited to 65536 vertices (indices are
+	// relative to the mesh's base vertex), in exchange the index buffer is half the size.
+	GeometryArena(GLsizei vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity,
+	              GLenum index_type = GL_UNSIGNED_INT);
+
+	// Arena for Vertex with its attribute formats set up (see VertexLayout.h)
+	template <typename Vertex>
+	static GeometryArena create(uint32_t vertex_capacity, uint32_t index_capacity, GLenum index_type = GL_UNSIGNED_INT)
+	{
+		GeometryArena arena((GLsizei)sizeof(Vertex), vertex_capacity, index_capacity, index_type);
+		arena.vao.vertex_buffer<Vertex>(0, arena.vertices);
+		return arena;
+	}
+
+	// Upload a mesh, indices are relative to its first vertex and narrowed to the arena's
+	// index type. Returns no_mesh if it doesn't fit or has no vertices or indices.
+	Mesh add(const void* vertex_data, uint32_t vertex_count, const uint32_t* index_data, uint32_t index_count);
+
+	template <typename Vertex>
+	Mesh add(const Vertex* vertex_data, uint32_t vertex_count, const uint32_t* index_data, uint32_t index_count)
+	{
+		if ((GLsizei)sizeof(Vertex) != stride)
+		{
+			std::cout << "ERROR::GEOMETRY_ARENA::VERTEX_SIZE_MISMATCH" << std::endl;
+			return no_mesh;
+		}
+		return add((const void*)vertex_data, vertex_count, index_data, index_count);
+	}
+
+	void remove(Mesh mesh);
+
+	// Current place of the mesh, changes when defragment() moves it
+	DrawRange range(Mesh mesh) const;
+
+	// Bind the shared VAO (skipped if bound) and draw one mesh
+	void draw(Mesh mesh) const;
+
+	// Move meshes from the end of the buffers into lower holes, copying at most max_bytes;
+	// only a single mesh larger than max_bytes is moved on its own. Returns the bytes copied,
+	// 0 once nothing can be moved down anymore.
+	GLsizeiptr defragment(GLsizeiptr max_bytes);
+
+	GLenum index_type() const { return element_type; }
+	GLsizeiptr index_size() const { return element_size; }
+
+	uint32_t free_vertices() const { return vertex_ranges.free_space(); }
+	uint32_t free_indices() const { return index_ranges.free_space(); }
+	const Stats& stats() const { return counters; }
+
+	// Delete the GL objects now, e.g. before the context is destroyed
+	void release();
+
+	Buffer vertices;
+	Buffer indices;
+	VertexArray vao;
+
+private:
+	struct Record
+	{
+		RangeAllocator::Range vertices;
+		RangeAllocator::Range indices;
+		bool alive = false;
+	};
+
+	GLsizei stride;
+	GLenum element_type;
+	GLsizeiptr element_size;
+	RangeAllocator vertex_ranges;
+	RangeAllocator index_ranges;
+	std::vector<Record> records;
+	std::vector<Mesh> free_records;
+	Stats counters;
+
+	bool valid(Mesh mesh) const { return mesh < records.size() && records[mesh].alive; }
+
+	// Move the highest allocation of ranges down if a lower hole fits it, returns bytes copied.
+	// Returns -1 without moving if that would copy more than budget (< 0 = no limit).
+	GLsizeiptr move_down(RangeAllocator& ranges, const Buffer& buffer, GLsizeiptr element_size, bool vertex_buffer,
+	                     GLsizeiptr budget);
+};
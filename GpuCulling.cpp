@@ -0,0 +1,290 @@
+#include "GpuCulling.h"
+
+namespace
+{
+	int previous_power_of_two(int value)
+	{
+		int power = 1;
+		while (power * 2 <= value)
+		{
+			power *= 2;
+		}
+		return power;
+	}
+}
+
+DepthPyramid::DepthPyramid(ComputeShader& program)
+	: program(program)
+{
+}
+
+DepthPyramid::~DepthPyramid()
+{
+	release();
+}
+
+void DepthPyramid::release()
+{
+	if (texture != 0)
+	{
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+	width = height = levels = 0;
+	depth_width = depth_height = 0;
+}
+
+void DepthPyramid::build(GLuint depth_texture, int source_width, int source_height)
+{
+	if (source_width <= 0 || source_height <= 0)
+	{
+		return;
+	}
+	if (source_width != depth_width || source_height != depth_height)
+	{
+		release();
+		depth_width  = source_width;
+		depth_height = source_height;
+		width  = previous_power_of_two(source_width);
+		height = previous_power_of_two(source_height);
+		levels = 1;
+		while ((width >> levels) > 0 || (height >> levels) > 0)
+		{
+			levels++;
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, levels, GL_R32F, width, height);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	// Each level reduces the one before, the first one reads the depth texture
+	glBindTextureUnit(0, depth_texture);
+	int previous_width  = depth_width;
+	int previous_height = depth_height;
+	for (int level = 0; level < levels; level++)
+	{
+		const int level_width  = std::max(1, width >> level);
+		const int level_height = std::max(1, height >> level);
+		glProgramUniform2i(program.id, 0, previous_width, previous_height);
+		glProgramUniform2i(program.id, 1, level_width, level_height);
+		glProgramUniform1i(program.id, 2, level == 0);
+		if (level > 0)
+		{
+			glBindImageTexture(0, texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		}
+		glBindImageTexture(1, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		program.dispatch(ComputeShader::group_count(level_width, 8), ComputeShader::group_count(level_height, 8));
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		previous_width  = level_width;
+		previous_height = level_height;
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+GpuCuller::GpuCuller(GeometryArena& arena, ComputeShader& program, uint32_t max_objects, GLuint binding_index)
+	: arena(arena),
+	  program(program),
+	  binding(binding_index),
+	  capacity(max_objects),
+	  objects((GLsizeiptr)max_objects * sizeof(CullObject), nullptr, GL_DYNAMIC_STORAGE_BIT),
+	  instances((GLsizeiptr)max_objects * sizeof(InstanceData), nullptr, GL_DYNAMIC_STORAGE_BIT),
+	  commands((GLsizeiptr)max_objects * sizeof(DrawElementsIndirectCommand), nullptr),
+	  count(sizeof(GLuint), nullptr),
+	  params(GL_UNIFORM_BUFFER)
+{
+	// glMultiDrawElementsIndirectCount is core in 4.6
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	count_supported = major > 4 || (major == 4 && minor >= 6);
+
+	object_data.reserve(max_objects);
+	instance_data.reserve(max_objects);
+	arena.vao.instance_buffer<InstanceData>(binding, instances.id);
+}
+
+GpuCuller::Object GpuCuller::add(GeometryArena::Mesh mesh, const glm::vec4& sphere, const InstanceData& instance)
+{
+	if (mesh == GeometryArena::no_mesh)
+	{
+		return no_object;
+	}
+
+	Object object;
+	if (!free_slots.empty())
+	{
+		object = free_slots.back();
+		free_slots.pop_back();
+	}
+	else if (object_limit < capacity)
+	{
+		object = object_limit++;
+		object_data.emplace_back();
+		instance_data.emplace_back();
+	}
+	else
+	{
+		std::cout << "ERROR::GPU_CULLER::FULL " << capacity << " objects" << std::endl;
+		return no_object;
+	}
+
+	object_data[object] = CullObject{ sphere, mesh, {} };
+	instance_data[object] = instance;
+	mesh_limit = std::max(mesh_limit, mesh + 1);
+	mark_dirty(object);
+	return object;
+}
+
+void GpuCuller::update(Object object, const glm::vec4& sphere, const InstanceData& instance)
+{
+	if (object >= object_limit || object_data[object].mesh == GeometryArena::no_mesh)
+	{
+		return;
+	}
+	object_data[object].sphere = sphere;
+	instance_data[object] = instance;
+	mark_dirty(object);
+}
+
+void GpuCuller::remove(Object object)
+{
+	if (object >= object_limit || object_data[object].mesh == GeometryArena::no_mesh)
+	{
+		return;
+	}
+	object_data[object].mesh = GeometryArena::no_mesh;
+	free_slots.push_back(object);
+	mark_dirty(object);
+}
+
+void GpuCuller::mark_dirty(Object object)
+{
+	if (dirty_begin == dirty_end)
+	{
+		dirty_begin = object;
+		dirty_end = object + 1;
+	}
+	else
+	{
+		dirty_begin = std::min(dirty_begin, object);
+		dirty_end = std::max(dirty_end, object + 1);
+	}
+}
+
+void GpuCuller::cull(const glm::mat4& view_projection, const DepthPyramid* pyramid)
+{
+	if (dirty_begin != dirty_end)
+	{
+		const uint32_t dirty = dirty_end - dirty_begin;
+		objects.update((GLintptr)dirty_begin * sizeof(CullObject), (GLsizeiptr)dirty * sizeof(CullObject),
+		               object_data.data() + dirty_begin);
+		instances.update((GLintptr)dirty_begin * sizeof(InstanceData), (GLsizeiptr)dirty * sizeof(InstanceData),
+		                 instance_data.data() + dirty_begin);
+		dirty_begin = dirty_end = 0;
+	}
+
+	// Ranges of every mesh as they are now, defragment() may have moved some
+	range_data.resize((size_t)mesh_limit * 4);
+	for (GeometryArena::Mesh mesh = 0; mesh < mesh_limit; mesh++)
+	{
+		const GeometryArena::DrawRange range = arena.range(mesh);
+		range_data[mesh * 4 + 0] = (uint32_t)range.index_count;
+		range_data[mesh * 4 + 1] = range.first_index;
+		range_data[mesh * 4 + 2] = (uint32_t)range.base_vertex;
+		range_data[mesh * 4 + 3] = 0;
+	}
+	const GLsizeiptr range_bytes = (GLsizeiptr)(range_data.size() * sizeof(uint32_t));
+	if (range_bytes > ranges.size)
+	{
+		GLsizeiptr size = 256;
+		while (size < range_bytes)
+		{
+			size *= 2;
+		}
+		ranges = Buffer(size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	if (range_bytes > 0)
+	{
+		ranges.update(0, range_bytes, range_data.data());
+	}
+
+	CullParams data = {};
+	data.view_projection = view_projection;
+	const Frustum frustum = Frustum::from_matrix(view_projection);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), data.planes);
+	data.object_count = object_limit;
+	data.mesh_count = mesh_limit;
+	if (pyramid && pyramid->texture != 0)
+	{
+		data.pyramid_size = glm::vec2((float)pyramid->width, (float)pyramid->height);
+		data.pyramid_levels = (uint32_t)pyramid->levels;
+		glBindTextureUnit(0, pyramid->texture);
+	}
+	params.update(data);
+	params.bind(0);
+
+	GLState& state = GLState::get();
+	state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, objects.id);
+	state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 1, ranges.id);
+	state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 2, commands.id);
+	state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 3, count.id);
+
+	// Without a count the draw reads every slot, the ones nothing was written to must be empty
+	glClearNamedBufferData(count.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	if (!count_supported && object_limit > 0)
+	{
+		glClearNamedBufferSubData(commands.id, GL_R32UI, 0, (GLsizeiptr)object_limit * sizeof(DrawElementsIndirectCommand),
+		                          GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	}
+
+	program.dispatch(ComputeShader::group_count(object_limit, 64));
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void GpuCuller::draw()
+{
+	if (object_limit == 0)
+	{
+		return;
+	}
+
+	glVertexArrayVertexBuffer(arena.vao.id, binding, instances.id, 0, (GLsizei)sizeof(InstanceData));
+	arena.vao.bind();
+
+	GLState& state = GLState::get();
+	state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.id);
+	if (count_supported)
+	{
+		state.bind_buffer(GL_PARAMETER_BUFFER, count.id);
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, arena.index_type(), nullptr, 0, (GLsizei)object_limit,
+		                                 (GLsizei)sizeof(DrawElementsIndirectCommand));
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, arena.index_type(), nullptr, (GLsizei)object_limit,
+		                            (GLsizei)sizeof(DrawElementsIndirectCommand));
+	}
+}
+
+uint32_t GpuCuller::visible_count() const
+{
+	GLuint visible = 0;
+	glGetNamedBufferSubData(count.id, 0, sizeof(visible), &visible);
+	return visible;
+}
+
+void GpuCuller::release()
+{
+	objects.release();
+	instances.release();
+	commands.release();
+	count.release();
+	ranges.release();
+	params.release();
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+#include "ComputeShader.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "Instancing.h"
+#include "MultiDraw.h"
+#include "UniformBlock.h"
+
+
+// Hierarchical-Z pyramid of a depth texture (depth_pyramid.comp). Every texel holds the
+// farthest depth of the area it covers, level 0 is the depth size rounded down to powers
+// of two. Build it from the finished depth buffer, GpuCuller tests the next frame against it.
+class DepthPyramid
+{
+public:
+	explicit DepthPyramid(ComputeShader& program);
+	~DepthPyramid();
+
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+	// Reduce a depth texture (GL_DEPTH_COMPONENT*, default compare mode) of width x height,
+	// the pyramid is recreated when the size changes
+	void build(GLuint depth_texture, int width, int height);
+
+	// Delete the GL objects now, e.g. before the context is destroyed
+	void release();
+
+	GLuint texture = 0;
+	int width = 0;  // of level 0
+	int height = 0;
+	int levels = 0;
+
+private:
+	ComputeShader& program;
+	int depth_width = 0;
+	int depth_height = 0;
+};
+
+// Bounding sphere and mesh of one culled object, std430 layout of cull.comp
+struct CullObject
+{
+	glm::vec4 sphere; // center, radius
+	uint32_t mesh;
+	uint32_t padding[3];
+
+	static constexpr size_t glsl_alignment = 16;
+};
+
+// Per frame parameters, std140 block CullParams of cull.comp
+struct CullParams
+{
+	glm::mat4 view_projection;
+	glm::vec4 planes[6];
+	glm::vec2 pyramid_size;
+	uint32_t object_count;
+	uint32_t mesh_count;
+	uint32_t pyramid_levels;
+	uint32_t padding[3];
+};
+static_assert(BlockLayoutCheck<BlockLayout::std140>()
+	.member<glm::mat4>(offsetof(CullParams, view_projection))
+	.member<glm::vec4[6]>(offsetof(CullParams, planes))
+	.member<glm::vec2>(offsetof(CullParams, pyramid_size))
+	.member<uint32_t>(offsetof(CullParams, object_count))
+	.member<uint32_t>(offsetof(CullParams, mesh_count))
+	.member<uint32_t>(offsetof(CullParams, pyramid_levels))
+	.fits(sizeof(CullParams)));
+
+// Visibility decided on the GPU. Objects (arena mesh, bounding sphere, instance data) live
+// in GPU buffers, cull() runs cull.comp over all of them and it appends one
+// DrawElementsIndirectCommand per visible object plus a draw count. draw() then submits
+// them with glMultiDrawElementsIndirectCount, without the CPU ever seeing the result.
+//
+// Each command's base instance is the object's index, so InstanceData is read straight from
+// the object's slot. Mesh ranges are uploaded every cull(), defragmenting the arena is fine.
+// Without GL 4.6 (Mesa's llvmpipe stops at 4.5) the command buffer is cleared before culling
+// and glMultiDrawElementsIndirect draws every slot. Survivors are packed to the front with
+// atomicAdd, so the tail past the visible count keeps its zeroed, empty commands.
+//
+//	GpuCuller culler(arena, cull_program, 1000000);
+//	GpuCuller::Object rock = culler.add(rock_mesh, sphere, instance);
+//	culler.cull(projection * view, &pyramid);
+//	shader.use();
+//	culler.draw();
+class GpuCuller
+{
+public:
+	using Object = uint32_t;
+	static constexpr Object no_object = ~0u;
+
+	// program is cull.comp, the arena's VAO reads instances at binding_index
+	GpuCuller(GeometryArena& arena, ComputeShader& program, uint32_t max_objects, GLuint binding_index = 1);
+
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	// sphere is the world space center and radius, returns no_object if full
+	Object add(GeometryArena::Mesh mesh, const glm::vec4& sphere, const InstanceData& instance);
+	void update(Object object, const glm::vec4& sphere, const InstanceData& instance);
+	void remove(Object object);
+
+	// Write the visible objects' commands. Without a pyramid (or before it was first built)
+	// only the frustum is tested.
+	void cull(const glm::mat4& view_projection, const DepthPyramid* pyramid = nullptr);
+
+	// Draw the last cull()'s commands with the current program
+	void draw();
+
+	// Objects that passed the last cull(), waits for the GPU (debugging/statistics only)
+	uint32_t visible_count() const;
+
+	// True if the driver draws with glMultiDrawElementsIndirectCount
+	bool count_draws() const { return count_supported; }
+
+	// Delete the GL objects now, e.g. before the context is destroyed
+	void release();
+
+private:
+	void mark_dirty(Object object);
+
+	GeometryArena& arena;
+	ComputeShader& program;
+	GLuint binding;
+	uint32_t capacity;
+	bool count_supported;
+
+	Buffer objects;   // CullObject per slot
+	Buffer instances; // InstanceData per slot
+	Buffer commands;  // DrawElementsIndirectCommand per slot
+	Buffer count;     // visible commands
+	Buffer ranges;    // index count, first index, base vertex, padding per mesh, grown as needed
+	BlockBuffer<CullParams> params;
+
+	// CPU copies, changed slots are uploaded in one range by the next cull()
+	std::vector<CullObject> object_data;   // mesh is no_mesh for free slots
+	std::vector<InstanceData> instance_data;
+	std::vector<Object> free_slots;
+	uint32_t object_limit = 0; // slots below this may be used
+	uint32_t dirty_begin = 0;
+	uint32_t dirty_end = 0;
+
+	uint32_t mesh_limit = 0;   // highest mesh used + 1
+	std::vector<uint32_t> range_data;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+
+// 64-bit FNV-1a, stable across runs and platforms so it can key on-disk data
+constexpr uint64_t fnv1a_offset = 0xcbf29ce484222325ull;
+constexpr uint64_t fnv1a_prime  = 0x100000001b3ull;
+
+// Chain through hash to hash data that is split over several pieces
+inline uint64_t fnv1a(std::string_view data, uint64_t hash = fnv1a_offset)
+{
+	for (unsigned char c : data)
+	{
+		hash ^= c;
+		hash *= fnv1a_prime;
+	}
+	return hash;
+}
+
+// Mix a value into a hash (e.g. a length so ("ab", "c") and ("a", "bc") differ)
+inline uint64_t fnv1a(uint64_t value, uint64_t hash)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= fnv1a_prime;
+	}
+	return hash;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GeometryArena.h"
+#include "StreamBuffer.h"
+#include "VertexLayout.h"
+
+
+// Per instance data read by shader.vert when INSTANCED is defined.
+// The transform is an affine 3x4 matrix stored as rows, world = (dot(row0, p), dot(row1, p), dot(row2, p)).
+struct InstanceData
+{
+	glm::vec4 row0;
+	glm::vec4 row1;
+	glm::vec4 row2;
+	glm::vec4 params; // free for the shader
+	unorm8x4 color;   // multiplies the vertex color
+};
+
+template <>
+struct VertexLayout<InstanceData>
+{
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(InstanceData, row0, 4),   // aModelRow0
+		VERTEX_ATTRIBUTE(InstanceData, row1, 5),   // aModelRow1
+		VERTEX_ATTRIBUTE(InstanceData, row2, 6),   // aModelRow2
+		VERTEX_ATTRIBUTE(InstanceData, params, 7), // aParams
+		VERTEX_ATTRIBUTE(InstanceData, color, 8),  // aInstanceColor
+	};
+};
+
+// Collects instances of arena meshes during the frame and draws them with one
+// glDrawElementsInstancedBaseVertexBaseInstance per mesh. All instances of a frame go
+// into one streamed region, each mesh's draw picks its slice through base instance, so
+// nothing is rebound between draws. draw() can be called several times per frame (e.g.
+// once per shader), end_frame() fences the region once all of them were issued.
+//
+//	InstanceBatcher<> batcher(arena, 100000);
+//	for (...) batcher.add(rock, instance);
+//	shader.use();
+//	batcher.draw();
+//	...
+//	batcher.end_frame();
+template <typename Instance = InstanceData>
+class InstanceBatcher
+{
+public:
+	// max_instances per frame (over all draw() calls), the arena's VAO reads them at binding_index
+	InstanceBatcher(GeometryArena& arena, size_t max_instances, GLuint binding_index = 1)
+		: arena(arena), stream((GLsizeiptr)(max_instances * sizeof(Instance))), binding(binding_index)
+	{
+		arena.vao.instance_buffer<Instance>(binding, stream.id);
+	}
+
+	InstanceBatcher(const InstanceBatcher&) = delete;
+	InstanceBatcher& operator=(const InstanceBatcher&) = delete;
+
+	void add(GeometryArena::Mesh mesh, const Instance& instance)
+	{
+		if (mesh == GeometryArena::no_mesh)
+		{
+			return;
+		}
+		if (mesh >= buckets.size())
+		{
+			buckets.resize(mesh + 1);
+		}
+		if (buckets[mesh].empty())
+		{
+			used.push_back(mesh);
+		}
+		buckets[mesh].push_back(instance);
+	}
+
+	// Upload what was added since the last call and draw it with the current program
+	void draw()
+	{
+		if (used.empty())
+		{
+			return;
+		}
+
+		size_t total = 0;
+		for (GeometryArena::Mesh mesh : used)
+		{
+			total += buckets[mesh].size();
+		}
+
+		if (!frame_started)
+		{
+			stream.begin_frame();
+			frame_started = true;
+		}
+		GLintptr offset = 0;
+		Instance* mapped = stream.allocate<Instance>(total, offset);
+		if (!mapped)
+		{
+			std::cout << "ERROR::INSTANCE_BATCHER::TOO_MANY_INSTANCES " << total << std::endl;
+		}
+		else
+		{
+			glVertexArrayVertexBuffer(arena.vao.id, binding, stream.id, offset, (GLsizei)sizeof(Instance));
+			arena.vao.bind();
+
+			GLuint base_instance = 0;
+			for (GeometryArena::Mesh mesh : used)
+			{
+				const std::vector<Instance>& instances = buckets[mesh];
+				std::memcpy(mapped + base_instance, instances.data(), instances.size() * sizeof(Instance));
+
+				const GeometryArena::DrawRange range = arena.range(mesh);
+				if (range.index_count > 0)
+				{
+					glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, range.index_count, arena.index_type(),
+						(const void*)((uintptr_t)range.first_index * arena.index_size()),
+						(GLsizei)instances.size(), range.base_vertex, base_instance);
+					calls++;
+				}
+				base_instance += (GLuint)instances.size();
+			}
+		}
+
+		for (GeometryArena::Mesh mesh : used)
+		{
+			buckets[mesh].clear();
+		}
+		used.clear();
+	}
+
+	// Fence this frame's stream region, call once after the frame's last draw()
+	void end_frame()
+	{
+		if (frame_started)
+		{
+			stream.end_frame();
+			frame_started = false;
+		}
+		last_calls = calls;
+		calls = 0;
+	}
+
+	// Draw calls issued in the last frame
+	size_t draw_calls() const { return last_calls; }
+
+	// Delete the GL objects now, e.g. before the context is destroyed
+	void release() { stream.release(); }
+
+private:
+	GeometryArena& arena;
+	StreamBuffer stream;
+	GLuint binding;
+	std::vector<std::vector<Instance>> buckets; // by mesh
+	std::vector<GeometryArena::Mesh> used;      // meshes with instances this frame, in first use order
+	bool frame_started = false; // stream region of this frame taken by a draw()
+	size_t calls = 0;
+	size_t last_calls = 0;
+};
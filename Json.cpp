@@ -0,0 +1,327 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	const Json null_value;
+	const std::string empty_string;
+
+	struct Parser
+	{
+		std::string_view text;
+		size_t position = 0;
+		std::string& error;
+
+		static constexpr int max_depth = 256;
+
+		void skip_whitespace()
+		{
+			while (position < text.size() &&
+				(text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+			{
+				position++;
+			}
+		}
+
+		bool fail(const char* message)
+		{
+			if (error.empty())
+			{
+				error = std::string(message) + " at offset " + std::to_string(position);
+			}
+			return false;
+		}
+
+		bool literal(std::string_view word)
+		{
+			if (text.substr(position, word.size()) != word)
+			{
+				return fail("unexpected token");
+			}
+			position += word.size();
+			return true;
+		}
+
+		static void append_utf8(std::string& out, uint32_t code)
+		{
+			if (code < 0x80)
+			{
+				out += (char)code;
+			}
+			else if (code < 0x800)
+			{
+				out += (char)(0xC0 | (code >> 6));
+				out += (char)(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				out += (char)(0xE0 | (code >> 12));
+				out += (char)(0x80 | ((code >> 6) & 0x3F));
+				out += (char)(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				out += (char)(0xF0 | (code >> 18));
+				out += (char)(0x80 | ((code >> 12) & 0x3F));
+				out += (char)(0x80 | ((code >> 6) & 0x3F));
+				out += (char)(0x80 | (code & 0x3F));
+			}
+		}
+
+		bool hex4(uint32_t& code)
+		{
+			if (position + 4 > text.size())
+			{
+				return fail("truncated escape");
+			}
+			code = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				const char c = text[position++];
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= c - '0';
+				else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+				else return fail("bad escape");
+			}
+			return true;
+		}
+
+		bool parse_string(std::string& out)
+		{
+			position++; // opening quote
+			while (position < text.size())
+			{
+				const char c = text[position++];
+				if (c == '"')
+				{
+					return true;
+				}
+				if (c != '\\')
+				{
+					out += c;
+					continue;
+				}
+				if (position >= text.size())
+				{
+					break;
+				}
+				const char escape = text[position++];
+				switch (escape)
+				{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					uint32_t code;
+					if (!hex4(code))
+					{
+						return false;
+					}
+					// Surrogate pair
+					if (code >= 0xD800 && code < 0xDC00 && text.substr(position, 2) == "\\u")
+					{
+						position += 2;
+						uint32_t low;
+						if (!hex4(low))
+						{
+							return false;
+						}
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					append_utf8(out, code);
+					break;
+				}
+				default:
+					return fail("bad escape");
+				}
+			}
+			return fail("unterminated string");
+		}
+
+		bool parse_value(Json& value, int depth)
+		{
+			if (depth > max_depth)
+			{
+				return fail("nesting too deep");
+			}
+			skip_whitespace();
+			if (position >= text.size())
+			{
+				return fail("unexpected end");
+			}
+
+			const char c = text[position];
+			if (c == '{')
+			{
+				value.type = Json::Type::Object;
+				position++;
+				skip_whitespace();
+				if (position < text.size() && text[position] == '}')
+				{
+					position++;
+					return true;
+				}
+				while (true)
+				{
+					skip_whitespace();
+					if (position >= text.size() || text[position] != '"')
+					{
+						return fail("expected member name");
+					}
+					value.object.emplace_back();
+					if (!parse_string(value.object.back().first))
+					{
+						return false;
+					}
+					skip_whitespace();
+					if (position >= text.size() || text[position] != ':')
+					{
+						return fail("expected ':'");
+					}
+					position++;
+					if (!parse_value(value.object.back().second, depth + 1))
+					{
+						return false;
+					}
+					skip_whitespace();
+					if (position < text.size() && text[position] == ',')
+					{
+						position++;
+						continue;
+					}
+					if (position < text.size() && text[position] == '}')
+					{
+						position++;
+						return true;
+					}
+					return fail("expected ',' or '}'");
+				}
+			}
+			if (c == '[')
+			{
+				value.type = Json::Type::Array;
+				position++;
+				skip_whitespace();
+				if (position < text.size() && text[position] == ']')
+				{
+					position++;
+					return true;
+				}
+				while (true)
+				{
+					value.array.emplace_back();
+					if (!parse_value(value.array.back(), depth + 1))
+					{
+						return false;
+					}
+					skip_whitespace();
+					if (position < text.size() && text[position] == ',')
+					{
+						position++;
+						continue;
+					}
+					if (position < text.size() && text[position] == ']')
+					{
+						position++;
+						return true;
+					}
+					return fail("expected ',' or ']'");
+				}
+			}
+			if (c == '"')
+			{
+				value.type = Json::Type::String;
+				return parse_string(value.string);
+			}
+			if (c == 't')
+			{
+				value.type = Json::Type::Bool;
+				value.boolean = true;
+				return literal("true");
+			}
+			if (c == 'f')
+			{
+				value.type = Json::Type::Bool;
+				return literal("false");
+			}
+			if (c == 'n')
+			{
+				return literal("null");
+			}
+
+			// strtod needs a terminated string, numbers are short so copy them
+			const size_t start = position;
+			while (position < text.size() && (std::strchr("+-.eE", text[position]) || (text[position] >= '0' && text[position] <= '9')))
+			{
+				position++;
+			}
+			if (position == start)
+			{
+				return fail("unexpected character");
+			}
+			const std::string number(text.substr(start, position - start));
+			char* end = nullptr;
+			value.type = Json::Type::Number;
+			value.number = std::strtod(number.c_str(), &end);
+			if (end != number.c_str() + number.size())
+			{
+				return fail("malformed number");
+			}
+			return true;
+		}
+	};
+}
+
+Json Json::parse(std::string_view text, std::string& error)
+{
+	error.clear();
+	Json root;
+	Parser parser{ text, 0, error };
+	if (!parser.parse_value(root, 0))
+	{
+		return Json();
+	}
+	parser.skip_whitespace();
+	if (parser.position != text.size())
+	{
+		parser.fail("trailing characters");
+		return Json();
+	}
+	return root;
+}
+
+const Json& Json::operator[](std::string_view key) const
+{
+	for (const auto& member : object)
+	{
+		if (member.first == key)
+		{
+			return member.second;
+		}
+	}
+	return null_value;
+}
+
+const Json& Json::operator[](size_t index) const
+{
+	return index < array.size() ? array[index] : null_value;
+}
+
+bool Json::has(std::string_view key) const
+{
+	return &(*this)[key] != &null_value;
+}
+
+const std::string& Json::string_or_empty() const
+{
+	return type == Type::String ? string : empty_string;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Small JSON document model, enough to read glTF. Objects keep their members in file order.
+// Lookups of missing keys or indices return a shared null value, so chains like
+// json["accessors"][3]["count"] never fail and defaults can be given at the end.
+class Json
+{
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	// Returns a null value and sets error on malformed input
+	static Json parse(std::string_view text, std::string& error);
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<Json> array;
+	std::vector<std::pair<std::string, Json>> object;
+
+	const Json& operator[](std::string_view key) const;
+	const Json& operator[](size_t index) const;
+	bool has(std::string_view key) const;
+	size_t size() const { return type == Type::Array ? array.size() : type == Type::Object ? object.size() : 0; }
+
+	bool is_null() const { return type == Type::Null; }
+	double number_or(double fallback) const { return type == Type::Number ? number : fallback; }
+	int64_t integer_or(int64_t fallback) const { return type == Type::Number ? (int64_t)number : fallback; }
+	bool boolean_or(bool fallback) const { return type == Type::Bool ? boolean : fallback; }
+	const std::string& string_or_empty() const;
+};
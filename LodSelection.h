@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "MeshFile.h"
+
+
+// Picks a level of detail from how large its simplification error appears on screen.
+// A level is good enough while its error projects to at most pixel_error pixels.
+// Hysteresis keeps objects near a threshold from flipping between levels every frame:
+// moving to a coarser level needs the error to fit with a margin, moving back to a finer
+// one only happens once the current level is really too coarse.
+struct LodView
+{
+	float projection_scale = 1.0f; // pixels per unit at distance 1: screen height / (2 tan(fovy / 2))
+	float pixel_error = 1.0f;
+	float hysteresis = 0.25f;      // fraction of pixel_error
+
+	static LodView perspective(float fovy_radians, float screen_height, float pixel_error = 1.0f)
+	{
+		LodView view;
+		view.projection_scale = screen_height / (2.0f * std::tan(fovy_radians * 0.5f));
+		view.pixel_error = pixel_error;
+		return view;
+	}
+
+	// Error in pixels of an object space error seen at distance
+	float projected(float error, float distance) const
+	{
+		return error * projection_scale / (distance > 1e-4f ? distance : 1e-4f);
+	}
+};
+
+// distance is from the camera to the object's bounds (center distance minus radius).
+// current is the level used last frame, lods are finest first with growing error.
+inline uint32_t select_lod(const MeshLod* lods, size_t lod_count, float distance, const LodView& view, uint32_t current)
+{
+	if (lod_count == 0)
+	{
+		return 0;
+	}
+
+	if (current < lod_count && view.projected(lods[current].error, distance) <= view.pixel_error)
+	{
+		// Current level is fine, only go coarser with a margin
+		const float coarser_limit = view.pixel_error * (1.0f - view.hysteresis);
+		while (current + 1 < lod_count && view.projected(lods[current + 1].error, distance) <= coarser_limit)
+		{
+			current++;
+		}
+		return current;
+	}
+
+	// Too coarse (or first frame): coarsest level that still fits
+	uint32_t level = 0;
+	while (level + 1 < lod_count && view.projected(lods[level + 1].error, distance) <= view.pixel_error)
+	{
+		level++;
+	}
+	return level;
+}
@@ -0,0 +1,174 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		address       = other.address;
+		size_         = other.size_;
+		opened        = other.opened;
+		error_message = std::move(other.error_message);
+#ifdef _WIN32
+		mapping       = other.mapping;
+		other.mapping = nullptr;
+#endif
+		other.address = nullptr;
+		other.size_   = 0;
+		other.opened  = false;
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+	                          nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		error_message = "CreateFile failed (" + std::to_string(GetLastError()) + ")";
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		error_message = "GetFileSizeEx failed (" + std::to_string(GetLastError()) + ")";
+		CloseHandle(file);
+		return false;
+	}
+
+	// Zero length files can't be mapped, treat them as an empty view
+	size_ = (size_t)file_size.QuadPart;
+	if (size_ > 0)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+		{
+			address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (!address)
+		{
+			error_message = "file mapping failed (" + std::to_string(GetLastError()) + ")";
+			CloseHandle(file);
+			close();
+			return false;
+		}
+	}
+
+	// The mapping keeps the file alive
+	CloseHandle(file);
+	opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (address)
+	{
+		UnmapViewOfFile(address);
+	}
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	mapping = nullptr;
+	address = nullptr;
+	size_   = 0;
+	opened  = false;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		error_message = std::strerror(errno);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		error_message = std::strerror(errno);
+		::close(fd);
+		return false;
+	}
+
+	// Zero length files can't be mapped, treat them as an empty view
+	size_ = (size_t)info.st_size;
+	if (size_ > 0)
+	{
+		void* result = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (result == MAP_FAILED)
+		{
+			error_message = std::strerror(errno);
+			::close(fd);
+			size_ = 0;
+			return false;
+		}
+		address = result;
+		madvise(address, size_, MADV_WILLNEED);
+	}
+
+	// The mapping keeps the file alive
+	::close(fd);
+	opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (address)
+	{
+		munmap(address, size_);
+	}
+	address = nullptr;
+	size_   = 0;
+	opened  = false;
+}
+
+#endif
+
+void MappedFile::prefetch() const
+{
+	// One read per 4 KiB page is enough to fault the whole file in
+	const volatile char* bytes = (const volatile char*)address;
+	char sink = 0;
+	for (size_t offset = 0; offset < size_; offset += 4096)
+	{
+		sink ^= bytes[offset];
+	}
+	(void)sink;
+}
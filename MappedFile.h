@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+
+// Read-only memory mapping of a whole file.
+// The mapped bytes can be handed straight to GL (e.g. glShaderSource with a length)
+// without copying them into a string first.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// Map the file at path, returns false and sets error() on failure
+	bool open(const char* path);
+	void close();
+
+	// Touch every page so later reads don't fault on disk (call from a worker thread)
+	void prefetch() const;
+
+	bool is_open() const { return opened; }
+	const char* data() const { return size_ ? (const char*)address : ""; }
+	size_t size() const { return size_; }
+	std::string_view view() const { return std::string_view(data(), size_); }
+
+	// Reason the last open() failed
+	const std::string& error() const { return error_message; }
+
+private:
+	void* address = nullptr;
+	size_t size_ = 0;
+	bool opened = false;
+	std::string error_message;
+#ifdef _WIN32
+	void* mapping = nullptr; // HANDLE of the file mapping object
+#endif
+};
@@ -0,0 +1,420 @@
+#include "MeshFile.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "Compression.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+namespace
+{
+	constexpr size_t stream_alignment  = 64;
+	constexpr size_t meshlet_vertices  = 64;
+	constexpr size_t meshlet_triangles = 124;
+	constexpr size_t min_compress_size = 1024; // smaller streams aren't worth it
+	constexpr uint64_t max_expansion   = 255;  // one length byte decodes to at most 255 bytes
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 read_position(const uint8_t* vertices, uint32_t stride, uint32_t offset, uint32_t vertex)
+	{
+		Float3 position;
+		std::memcpy(&position, vertices + (size_t)vertex * stride + offset, sizeof(position));
+		return position;
+	}
+
+	// Split the triangles of one LOD into meshlets in index order, which is already
+	// cache optimized so neighbouring triangles end up together
+	void build_meshlets(const uint8_t* vertices, uint32_t stride, uint32_t position_offset, size_t vertex_count,
+	                    const uint32_t* indices, const MeshLod& lod, std::vector<Meshlet>& meshlets)
+	{
+		std::vector<uint32_t> seen(vertex_count, ~0u); // meshlet that last used the vertex
+		std::vector<uint32_t> meshlet_vertex_list;
+
+		auto finish = [&](uint32_t first_index, uint32_t index_count)
+		{
+			Meshlet meshlet = {};
+			meshlet.first_index = first_index;
+			meshlet.index_count = index_count;
+
+			// Bounding sphere around the box center
+			Float3 low = read_position(vertices, stride, position_offset, meshlet_vertex_list[0]);
+			Float3 high = low;
+			for (uint32_t vertex : meshlet_vertex_list)
+			{
+				const Float3 p = read_position(vertices, stride, position_offset, vertex);
+				low  = { std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z) };
+				high = { std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z) };
+			}
+			const Float3 center = { (low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f };
+			float radius = 0.0f;
+			for (uint32_t vertex : meshlet_vertex_list)
+			{
+				const Float3 p = read_position(vertices, stride, position_offset, vertex);
+				radius = std::max(radius, std::sqrt((p.x - center.x) * (p.x - center.x) + (p.y - center.y) * (p.y - center.y) +
+				                                    (p.z - center.z) * (p.z - center.z)));
+			}
+			meshlet.center[0] = center.x;
+			meshlet.center[1] = center.y;
+			meshlet.center[2] = center.z;
+			meshlet.radius = radius;
+
+			// Normal cone: average facing and how far the triangles stray from it
+			std::vector<Float3> normals;
+			Float3 axis = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = first_index; i < first_index + index_count; i += 3)
+			{
+				const Float3 a = read_position(vertices, stride, position_offset, indices[i]);
+				const Float3 b = read_position(vertices, stride, position_offset, indices[i + 1]);
+				const Float3 c = read_position(vertices, stride, position_offset, indices[i + 2]);
+				const Float3 ab = { b.x - a.x, b.y - a.y, b.z - a.z };
+				const Float3 ac = { c.x - a.x, c.y - a.y, c.z - a.z };
+				Float3 n = { ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+				const float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+				if (length == 0.0f)
+				{
+					continue;
+				}
+				n = { n.x / length, n.y / length, n.z / length };
+				normals.push_back(n);
+				axis = { axis.x + n.x, axis.y + n.y, axis.z + n.z };
+			}
+			const float axis_length = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+			meshlet.cone_cutoff = -1.0f;
+			if (axis_length > 0.0f)
+			{
+				axis = { axis.x / axis_length, axis.y / axis_length, axis.z / axis_length };
+				float cutoff = 1.0f;
+				for (const Float3& n : normals)
+				{
+					cutoff = std::min(cutoff, n.x * axis.x + n.y * axis.y + n.z * axis.z);
+				}
+				meshlet.cone_axis[0] = axis.x;
+				meshlet.cone_axis[1] = axis.y;
+				meshlet.cone_axis[2] = axis.z;
+				meshlet.cone_cutoff = cutoff;
+			}
+
+			meshlets.push_back(meshlet);
+			meshlet_vertex_list.clear();
+		};
+
+		uint32_t first = lod.first_index;
+		for (uint32_t i = lod.first_index; i < lod.first_index + lod.index_count; i += 3)
+		{
+			const uint32_t id = (uint32_t)meshlets.size();
+			size_t new_vertices = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				new_vertices += seen[indices[i + k]] != id;
+			}
+			if (meshlet_vertex_list.size() + new_vertices > meshlet_vertices || (i - first) / 3 >= meshlet_triangles)
+			{
+				finish(first, i - first);
+				first = i;
+			}
+
+			const uint32_t current = (uint32_t)meshlets.size();
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				if (seen[indices[i + k]] != current)
+				{
+					seen[indices[i + k]] = current;
+					meshlet_vertex_list.push_back(indices[i + k]);
+				}
+			}
+		}
+		if (!meshlet_vertex_list.empty())
+		{
+			finish(first, lod.first_index + lod.index_count - first);
+		}
+	}
+}
+
+bool MeshFile::cook(const char* path, const VertexAttribute* attributes, size_t attribute_count, uint32_t vertex_stride,
+                    const void* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count,
+                    const MeshCookOptions& options)
+{
+	if (attribute_count == 0 || vertex_count == 0 || vertex_count > 0xFFFFFFFFu || index_count % 3 != 0)
+	{
+		std::cout << "ERROR::MESH_FILE::INVALID_MESH\n" << path << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < index_count; i++)
+	{
+		if (indices[i] >= vertex_count)
+		{
+			std::cout << "ERROR::MESH_FILE::INDEX_OUT_OF_RANGE\n" << path << std::endl;
+			return false;
+		}
+	}
+
+	// Bounds, meshlets and LOD generation need float positions at location 0
+	const VertexAttribute* position = nullptr;
+	for (size_t i = 0; i < attribute_count; i++)
+	{
+		if (attributes[i].location == 0 && attributes[i].type == GL_FLOAT && attributes[i].size >= 3)
+		{
+			position = &attributes[i];
+		}
+	}
+	const uint8_t* vertex_bytes = (const uint8_t*)vertices;
+
+	std::vector<MeshLod> lods = options.lods;
+	std::vector<uint32_t> lod_indices;
+	if (lods.empty() && options.generate_lods && position)
+	{
+		// The coarser levels are appended behind the full index list
+		lod_indices.assign(indices, indices + index_count);
+		lods = build_lod_chain(lod_indices, (const float*)(vertex_bytes + position->offset), vertex_stride, vertex_count);
+		indices = lod_indices.data();
+		index_count = lod_indices.size();
+	}
+	if (lods.empty())
+	{
+		lods.push_back({ 0, (uint32_t)index_count, 0, 0, 0.0f, 0 });
+	}
+
+	MeshFileHeader header = {};
+	header.magic = mesh_file_magic;
+	header.version = mesh_file_version;
+	header.vertex_stride = vertex_stride;
+	header.vertex_count = (uint32_t)vertex_count;
+	header.index_count = (uint32_t)index_count;
+
+	std::vector<Meshlet> meshlets;
+	if (position)
+	{
+		Float3 low = read_position(vertex_bytes, vertex_stride, position->offset, 0);
+		Float3 high = low;
+		for (uint32_t v = 1; v < vertex_count; v++)
+		{
+			const Float3 p = read_position(vertex_bytes, vertex_stride, position->offset, v);
+			low  = { std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z) };
+			high = { std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z) };
+		}
+		std::memcpy(header.bounds_min, &low, sizeof(low));
+		std::memcpy(header.bounds_max, &high, sizeof(high));
+
+		for (MeshLod& lod : lods)
+		{
+			if ((size_t)lod.first_index + lod.index_count > index_count)
+			{
+				std::cout << "ERROR::MESH_FILE::LOD_OUT_OF_RANGE\n" << path << std::endl;
+				return false;
+			}
+			lod.first_meshlet = (uint32_t)meshlets.size();
+			build_meshlets(vertex_bytes, vertex_stride, position->offset, vertex_count, indices, lod, meshlets);
+			lod.meshlet_count = (uint32_t)meshlets.size() - lod.first_meshlet;
+		}
+	}
+
+	std::vector<MeshFileAttribute> attribute_records;
+	for (size_t i = 0; i < attribute_count; i++)
+	{
+		const VertexAttribute& a = attributes[i];
+		attribute_records.push_back({ a.location, (uint32_t)a.size, a.type, a.normalized, (uint32_t)a.kind, a.offset, a.bytes });
+	}
+
+	const IndexData packed_indices = compact_indices(indices, index_count, vertex_count);
+	header.index_type = packed_indices.type;
+
+	struct Source
+	{
+		const void* data;
+		size_t size;
+		size_t element_size;
+	};
+	const Source sources[MeshStreamCount] = {
+		{ attribute_records.data(), attribute_records.size() * sizeof(MeshFileAttribute), sizeof(MeshFileAttribute) },
+		{ vertices, vertex_count * vertex_stride, vertex_stride },
+		{ packed_indices.data(), (size_t)packed_indices.bytes(), packed_indices.type == GL_UNSIGNED_SHORT ? 2u : 4u },
+		{ meshlets.data(), meshlets.size() * sizeof(Meshlet), sizeof(Meshlet) },
+		{ lods.data(), lods.size() * sizeof(MeshLod), sizeof(MeshLod) },
+	};
+
+	// Compress what gets smaller, keep the rest as is
+	std::vector<uint8_t> compressed[MeshStreamCount];
+	uint64_t offset = (sizeof(MeshFileHeader) + stream_alignment - 1) / stream_alignment * stream_alignment;
+	for (int i = 0; i < MeshStreamCount; i++)
+	{
+		MeshStreamEntry& entry = header.streams[i];
+		entry.raw_size = sources[i].size;
+		entry.size = sources[i].size;
+		entry.element_size = (uint32_t)sources[i].element_size;
+		if (options.compress && sources[i].size >= min_compress_size)
+		{
+			compressed[i] = compress_stream(sources[i].data, sources[i].size, sources[i].element_size);
+			if (compressed[i].size() < sources[i].size)
+			{
+				entry.compressed = 1;
+				entry.size = compressed[i].size();
+			}
+		}
+		entry.offset = offset;
+		offset = (offset + entry.size + stream_alignment - 1) / stream_alignment * stream_alignment;
+	}
+
+	// Write to a temporary file then rename so a crash never leaves a half written mesh
+	std::filesystem::path temp_path = path;
+	temp_path += ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::MESH_FILE::WRITE_FAILED\n" << temp_path.string() << std::endl;
+			return false;
+		}
+		const char padding[stream_alignment] = {};
+		file.write((const char*)&header, sizeof(header));
+		uint64_t written = sizeof(header);
+		for (int i = 0; i < MeshStreamCount; i++)
+		{
+			const MeshStreamEntry& entry = header.streams[i];
+			file.write(padding, (std::streamsize)(entry.offset - written));
+			file.write(entry.compressed ? (const char*)compressed[i].data() : (const char*)sources[i].data, (std::streamsize)entry.size);
+			written = entry.offset + entry.size;
+		}
+		if (!file)
+		{
+			std::cout << "ERROR::MESH_FILE::WRITE_FAILED\n" << temp_path.string() << std::endl;
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		std::cout << "ERROR::MESH_FILE::WRITE_FAILED\n" << path << ": " << ec.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::open(const char* path)
+{
+	header_data = nullptr;
+	decoded.clear();
+	vertex_attributes.clear();
+
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::MESH_FILE::FILE_NOT_SUCCESSFULLY_READ\n" << path << ": " << file.error() << std::endl;
+		return false;
+	}
+
+	const MeshFileHeader* header = (const MeshFileHeader*)file.data();
+	if (file.size() < sizeof(MeshFileHeader) || header->magic != mesh_file_magic || header->version != mesh_file_version)
+	{
+		std::cout << "ERROR::MESH_FILE::NOT_A_MESH_FILE\n" << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	for (int i = 0; i < MeshStreamCount; i++)
+	{
+		const MeshStreamEntry& entry = header->streams[i];
+		if (entry.offset > file.size() || entry.size > file.size() - entry.offset)
+		{
+			std::cout << "ERROR::MESH_FILE::TRUNCATED\n" << path << std::endl;
+			file.close();
+			return false;
+		}
+
+		const char* data = file.data() + entry.offset;
+		if (!entry.compressed)
+		{
+			streams[i] = std::string_view(data, (size_t)entry.size);
+			continue;
+		}
+		// raw_size comes from the file, don't let a corrupt one pick the allocation size
+		if (entry.raw_size > (entry.size + 1) * max_expansion)
+		{
+			std::cout << "ERROR::MESH_FILE::CORRUPT_STREAM " << i << "\n" << path << std::endl;
+			file.close();
+			return false;
+		}
+		decoded.emplace_back((size_t)entry.raw_size);
+		if (!decompress_stream(data, (size_t)entry.size, decoded.back().data(), (size_t)entry.raw_size, entry.element_size))
+		{
+			std::cout << "ERROR::MESH_FILE::CORRUPT_STREAM " << i << "\n" << path << std::endl;
+			file.close();
+			return false;
+		}
+		streams[i] = std::string_view((const char*)decoded.back().data(), decoded.back().size());
+	}
+
+	// The stream sizes have to agree with the header before anything is handed to GL
+	const size_t index_size = header->index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+	if (streams[MeshStreamVertices].size() != (size_t)header->vertex_count * header->vertex_stride ||
+		streams[MeshStreamIndices].size() != (size_t)header->index_count * index_size ||
+		streams[MeshStreamAttributes].size() % sizeof(MeshFileAttribute) != 0 ||
+		streams[MeshStreamMeshlets].size() % sizeof(Meshlet) != 0 ||
+		streams[MeshStreamLods].size() % sizeof(MeshLod) != 0)
+	{
+		std::cout << "ERROR::MESH_FILE::INCONSISTENT_HEADER\n" << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	// Every range is used for draws and reads without further checks
+	bool ranges_valid = lod_count() >= 1;
+	for (size_t i = 0; i < lod_count() && ranges_valid; i++)
+	{
+		MeshLod lod;
+		std::memcpy(&lod, streams[MeshStreamLods].data() + i * sizeof(lod), sizeof(lod));
+		ranges_valid = (uint64_t)lod.first_index + lod.index_count <= header->index_count &&
+		               (uint64_t)lod.first_meshlet + lod.meshlet_count <= meshlet_count();
+	}
+	for (size_t i = 0; i < meshlet_count() && ranges_valid; i++)
+	{
+		Meshlet meshlet;
+		std::memcpy(&meshlet, streams[MeshStreamMeshlets].data() + i * sizeof(meshlet), sizeof(meshlet));
+		ranges_valid = (uint64_t)meshlet.first_index + meshlet.index_count <= header->index_count;
+	}
+	if (!ranges_valid)
+	{
+		std::cout << "ERROR::MESH_FILE::RANGE_OUT_OF_BOUNDS\n" << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	const size_t attribute_count = streams[MeshStreamAttributes].size() / sizeof(MeshFileAttribute);
+	for (size_t i = 0; i < attribute_count; i++)
+	{
+		MeshFileAttribute record;
+		std::memcpy(&record, streams[MeshStreamAttributes].data() + i * sizeof(record), sizeof(record));
+		vertex_attributes.push_back({ record.location, (GLint)record.size, record.type, (GLboolean)record.normalized,
+		                              (AttributeKind)record.kind, record.offset, record.bytes });
+	}
+
+	header_data = header;
+	return true;
+}
+
+Buffer MeshFile::vertex_buffer(GLbitfield flags) const
+{
+	const std::string_view data = streams[MeshStreamVertices];
+	return Buffer((GLsizeiptr)data.size(), data.data(), flags);
+}
+
+Buffer MeshFile::index_buffer(GLbitfield flags) const
+{
+	const std::string_view data = streams[MeshStreamIndices];
+	return Buffer((GLsizeiptr)data.size(), data.data(), flags);
+}
+
+void MeshFile::setup(VertexArray& vao, const Buffer& vertices, const Buffer& indices, GLuint binding_index) const
+{
+	vao.vertex_buffer(binding_index, vertices, (GLsizei)header_data->vertex_stride,
+	                  vertex_attributes.data(), vertex_attributes.size());
+	vao.element_buffer(indices);
+}
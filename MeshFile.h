@@ -0,0 +1,146 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include "Buffer.h"
+#include "MappedFile.h"
+#include "VertexArray.h"
+#include "VertexLayout.h"
+
+
+// Cooked mesh: everything the GPU needs, in the layout it needs it, so loading is
+// mapping the file and handing the blobs to glNamedBufferStorage.
+//
+//	header | stream data, each 64 byte aligned
+//
+// Streams are the attribute descriptors, vertices, indices (16 bit when they fit),
+// meshlets and LODs. Each can be compressed (Compression.h), compressed streams are
+// decoded once when the file is opened, the others are used straight from the mapping.
+// Little endian only, like every platform GL runs on.
+
+constexpr uint32_t mesh_file_magic   = 0x4853454D; // "MESH"
+constexpr uint32_t mesh_file_version = 1;
+
+enum MeshStream
+{
+	MeshStreamAttributes,
+	MeshStreamVertices,
+	MeshStreamIndices,
+	MeshStreamMeshlets,
+	MeshStreamLods,
+	MeshStreamCount
+};
+
+struct MeshStreamEntry
+{
+	uint64_t offset;       // from the start of the file
+	uint64_t size;         // bytes in the file
+	uint64_t raw_size;     // bytes once decoded
+	uint32_t compressed;   // 0 or 1
+	uint32_t element_size; // for the byte transpose of compressed streams
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertex_stride;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t index_type;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	float bounds_min[3];
+	float bounds_max[3];
+	MeshStreamEntry streams[MeshStreamCount];
+};
+
+// VertexAttribute with fixed size fields
+struct MeshFileAttribute
+{
+	uint32_t location, size, type, normalized, kind, offset, bytes;
+};
+
+// Cluster of up to 64 vertices / 124 triangles, for culling ranges of the index buffer
+struct Meshlet
+{
+	float center[3];
+	float radius;
+	float cone_axis[3];   // average facing
+	float cone_cutoff;    // smallest dot(cone_axis, triangle normal), -1 if the facings don't agree
+	uint32_t first_index;
+	uint32_t index_count;
+};
+
+// One detail level: a range of the index buffer and its meshlets
+struct MeshLod
+{
+	uint32_t first_index;
+	uint32_t index_count;
+	uint32_t first_meshlet;
+	uint32_t meshlet_count;
+	float error;          // object space simplification error, 0 for the full mesh
+	uint32_t reserved;
+};
+
+struct MeshCookOptions
+{
+	bool compress = true;
+	// Index ranges of the detail levels in the index list, finest first. Empty means one
+	// level with every index. Meshlets need a float xyz attribute at location 0.
+	std::vector<MeshLod> lods;
+	// With lods empty, simplify the mesh into a LOD chain (MeshSimplifier.h), also needs
+	// the float xyz attribute at location 0
+	bool generate_lods = false;
+};
+
+class MeshFile
+{
+public:
+	// Write a cooked mesh. indices are 32 bit here, they are narrowed when the vertex count allows.
+	static bool cook(const char* path, const VertexAttribute* attributes, size_t attribute_count, uint32_t vertex_stride,
+	                 const void* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count,
+	                 const MeshCookOptions& options = {});
+
+	template <typename Vertex>
+	static bool cook(const char* path, const Vertex* vertices, size_t vertex_count,
+	                 const uint32_t* indices, size_t index_count, const MeshCookOptions& options = {})
+	{
+		return cook(path, VertexLayout<Vertex>::attributes, std::size(VertexLayout<Vertex>::attributes), sizeof(Vertex),
+		            vertices, vertex_count, indices, index_count, options);
+	}
+
+	// Map and validate a cooked mesh (stream sizes, LOD and meshlet ranges, at least one LOD),
+	// returns false and prints the reason on failure
+	bool open(const char* path);
+
+	const MeshFileHeader& header() const { return *header_data; }
+	std::string_view stream(MeshStream id) const { return streams[id]; }
+
+	const std::vector<VertexAttribute>& attributes() const { return vertex_attributes; }
+	GLenum index_type() const { return header_data->index_type; }
+	GLsizeiptr index_size() const { return header_data->index_type == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+	const Meshlet* meshlets() const { return (const Meshlet*)streams[MeshStreamMeshlets].data(); }
+	size_t meshlet_count() const { return streams[MeshStreamMeshlets].size() / sizeof(Meshlet); }
+	const MeshLod* lods() const { return (const MeshLod*)streams[MeshStreamLods].data(); }
+	size_t lod_count() const { return streams[MeshStreamLods].size() / sizeof(MeshLod); }
+
+	// GPU buffers filled straight from the file
+	Buffer vertex_buffer(GLbitfield flags = 0) const;
+	Buffer index_buffer(GLbitfield flags = 0) const;
+
+	// Attribute formats of the file on vao, reading from vertices and indices
+	void setup(VertexArray& vao, const Buffer& vertices, const Buffer& indices, GLuint binding_index = 0) const;
+
+private:
+	MappedFile file;
+	const MeshFileHeader* header_data = nullptr;
+	std::string_view streams[MeshStreamCount];
+	std::vector<std::vector<uint8_t>> decoded; // storage of decompressed streams
+	std::vector<VertexAttribute> vertex_attributes;
+};
@@ -0,0 +1,1075 @@
+#include "MeshImporter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string_view>
+
+#include "Hash.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+
+namespace
+{
+	// Below this many items a parallel_for range isn't worth a thread
+	constexpr size_t min_parallel_range = 16384;
+
+	bool ends_with(const std::string& text, std::string_view suffix)
+	{
+		if (text.size() < suffix.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < suffix.size(); i++)
+		{
+			char c = text[text.size() - suffix.size() + i];
+			if (c >= 'A' && c <= 'Z')
+			{
+				c = c - 'A' + 'a';
+			}
+			if (c != suffix[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string directory_of(const std::string& path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	// Merge equal items. Items are split into shards by hash, each shard is deduplicated by
+	// its own thread with an open addressing table. Ids are then renumbered in order of first
+	// occurrence, so the result doesn't depend on the thread count.
+	// remap[i] is the id of item i, first[id] the first item with that id.
+	template <typename Equal>
+	void deduplicate(const std::vector<uint64_t>& hashes, unsigned int threads, Equal equal,
+	                 std::vector<uint32_t>& remap, std::vector<uint32_t>& first)
+	{
+		const size_t count = hashes.size();
+		const size_t shards = std::max(1u, threads);
+		auto shard_of = [shards](uint64_t hash) { return (size_t)((hash >> 40) % shards); };
+
+		// Scatter the items into one list per shard, in item order: every block counts its items
+		// per shard, a prefix sum turns the counts into write offsets, then every block writes
+		// its items. Each shard then only walks its own list.
+		const size_t blocks = shards;
+		const size_t block_size = (count + blocks - 1) / blocks;
+		std::vector<uint32_t> offsets(blocks * shards, 0); // [block * shards + shard]
+		parallel_for(blocks, threads, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t block = begin; block < end; block++)
+			{
+				const size_t last = std::min(count, (block + 1) * block_size);
+				for (size_t i = block * block_size; i < last; i++)
+				{
+					offsets[block * shards + shard_of(hashes[i])]++;
+				}
+			}
+		});
+		std::vector<uint32_t> shard_start(shards + 1, 0);
+		uint32_t running = 0;
+		for (size_t shard = 0; shard < shards; shard++)
+		{
+			shard_start[shard] = running;
+			for (size_t block = 0; block < blocks; block++)
+			{
+				const uint32_t items = offsets[block * shards + shard];
+				offsets[block * shards + shard] = running;
+				running += items;
+			}
+		}
+		shard_start[shards] = running;
+		std::vector<uint32_t> shard_items(count);
+		parallel_for(blocks, threads, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t block = begin; block < end; block++)
+			{
+				const size_t last = std::min(count, (block + 1) * block_size);
+				for (size_t i = block * block_size; i < last; i++)
+				{
+					shard_items[offsets[block * shards + shard_of(hashes[i])]++] = (uint32_t)i;
+				}
+			}
+		});
+
+		remap.assign(count, 0);
+		std::vector<uint32_t> shard_unique(shards, 0);
+		parallel_for(shards, threads, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t shard = begin; shard < end; shard++)
+			{
+				const uint32_t* items = shard_items.data() + shard_start[shard];
+				const size_t item_count = shard_start[shard + 1] - shard_start[shard];
+				size_t table_size = 16;
+				while (table_size < item_count * 2)
+				{
+					table_size *= 2;
+				}
+				const size_t mask = table_size - 1;
+				std::vector<uint32_t> table(table_size, ~0u);
+
+				uint32_t unique = 0;
+				for (size_t item = 0; item < item_count; item++)
+				{
+					const uint32_t i = items[item];
+					const uint64_t hash = hashes[i];
+					for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+					{
+						const uint32_t other = table[slot];
+						if (other == ~0u)
+						{
+							table[slot] = i;
+							remap[i] = unique++;
+							break;
+						}
+						if (hashes[other] == hash && equal(i, other))
+						{
+							remap[i] = remap[other];
+							break;
+						}
+					}
+				}
+				shard_unique[shard] = unique;
+			}
+		});
+
+		std::vector<uint32_t> shard_base(shards, 0);
+		size_t total = 0;
+		for (size_t shard = 0; shard < shards; shard++)
+		{
+			shard_base[shard] = (uint32_t)total;
+			total += shard_unique[shard];
+		}
+
+		std::vector<uint32_t> order(total, ~0u);
+		first.clear();
+		first.reserve(total);
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t id = shard_base[shard_of(hashes[i])] + remap[i];
+			if (order[id] == ~0u)
+			{
+				order[id] = (uint32_t)first.size();
+				first.push_back((uint32_t)i);
+			}
+			remap[i] = order[id];
+		}
+	}
+
+	void optimize(ImportedMesh& mesh)
+	{
+		uint32_t* indices = mesh.indices.data();
+		const size_t index_count = mesh.indices.size();
+		optimize_vertex_cache(indices, index_count, mesh.vertices.size());
+		optimize_overdraw(indices, index_count, &mesh.vertices[0].position.x, sizeof(ImportedVertex), mesh.vertices.size());
+		const size_t used = optimize_vertex_fetch(mesh.vertices.data(), sizeof(ImportedVertex), mesh.vertices.size(), indices, index_count);
+		mesh.vertices.resize(used);
+	}
+
+
+	// OBJ
+	// ---
+
+	struct ObjCorner
+	{
+		int64_t index[3];  // position, uv, normal
+		uint8_t relative;  // bit per index: negative OBJ index, relative to the chunk's start
+		uint8_t present;   // bit per index
+	};
+
+	struct ObjChunk
+	{
+		std::vector<float> positions; // xyz
+		std::vector<float> uvs;       // uv
+		std::vector<float> normals;   // xyz
+		std::vector<ObjCorner> corners;
+		std::string error;
+	};
+
+	const char* skip_blanks(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	const char* read_floats(const char* p, const char* end, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			p = skip_blanks(p, end);
+			out[i] = 0.0f;
+			if (p < end && *p == '+')
+			{
+				p++;
+			}
+			const std::from_chars_result result = std::from_chars(p, end, out[i]);
+			if (result.ec != std::errc())
+			{
+				return nullptr;
+			}
+			p = result.ptr;
+		}
+		return p;
+	}
+
+	bool read_corner(const char*& p, const char* end, ObjChunk& chunk, ObjCorner& corner)
+	{
+		// p, p/t, p//n or p/t/n
+		const size_t counts[3] = { chunk.positions.size() / 3, chunk.uvs.size() / 2, chunk.normals.size() / 3 };
+		corner = ObjCorner();
+		for (int component = 0; component < 3; component++)
+		{
+			if (component > 0)
+			{
+				if (p >= end || *p != '/')
+				{
+					break;
+				}
+				p++;
+				if (p < end && *p == '/')
+				{
+					continue;
+				}
+			}
+			int64_t value = 0;
+			const std::from_chars_result result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || value == 0)
+			{
+				return false;
+			}
+			p = result.ptr;
+			corner.present |= 1 << component;
+			if (value > 0)
+			{
+				corner.index[component] = value - 1;
+			}
+			else
+			{
+				corner.index[component] = (int64_t)counts[component] + value;
+				corner.relative |= 1 << component;
+			}
+		}
+		return (corner.present & 1) != 0;
+	}
+
+	void parse_obj_chunk(const char* begin, const char* end, ObjChunk& chunk)
+	{
+		std::vector<ObjCorner> polygon;
+		for (const char* line = begin; line < end;)
+		{
+			const char* line_end = (const char*)std::memchr(line, '\n', end - line);
+			if (!line_end)
+			{
+				line_end = end;
+			}
+
+			const char* p = skip_blanks(line, line_end);
+			if (p + 1 < line_end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				float values[3];
+				if (!read_floats(p + 1, line_end, values, 3))
+				{
+					chunk.error = "malformed vertex: " + std::string(line, line_end);
+					return;
+				}
+				chunk.positions.insert(chunk.positions.end(), values, values + 3);
+			}
+			else if (p + 2 < line_end && p[0] == 'v' && p[1] == 'n')
+			{
+				float values[3];
+				if (!read_floats(p + 2, line_end, values, 3))
+				{
+					chunk.error = "malformed normal: " + std::string(line, line_end);
+					return;
+				}
+				chunk.normals.insert(chunk.normals.end(), values, values + 3);
+			}
+			else if (p + 2 < line_end && p[0] == 'v' && p[1] == 't')
+			{
+				// The second coordinate is optional
+				float values[2] = { 0.0f, 0.0f };
+				const char* after = read_floats(p + 2, line_end, values, 1);
+				if (!after)
+				{
+					chunk.error = "malformed texture coordinate: " + std::string(line, line_end);
+					return;
+				}
+				read_floats(after, line_end, values + 1, 1);
+				chunk.uvs.insert(chunk.uvs.end(), values, values + 2);
+			}
+			else if (p + 1 < line_end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				polygon.clear();
+				p = skip_blanks(p + 1, line_end);
+				while (p < line_end)
+				{
+					ObjCorner corner;
+					if (!read_corner(p, line_end, chunk, corner))
+					{
+						chunk.error = "malformed face: " + std::string(line, line_end);
+						return;
+					}
+					polygon.push_back(corner);
+					p = skip_blanks(p, line_end);
+				}
+				// Fan triangulation, fine for the convex polygons exporters write
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i - 1]);
+					chunk.corners.push_back(polygon[i]);
+				}
+			}
+			// Everything else (groups, materials, smoothing, lines) is ignored
+
+			line = line_end + 1;
+		}
+	}
+}
+
+ImportedMesh import_obj(const std::string& path, const ImportOptions& options)
+{
+	ImportedMesh mesh;
+	MappedFile file;
+	if (!file.open(path.c_str()))
+	{
+		std::cout << "ERROR::MESH_IMPORTER::FILE_NOT_SUCCESSFULLY_READ\n" << path << ": " << file.error() << std::endl;
+		return mesh;
+	}
+	const unsigned int threads = worker_count(options.threads);
+
+	// 1. parse chunks split at line breaks, each into its own arrays
+	const char* data = file.data();
+	const size_t size = file.size();
+	const size_t chunk_count = std::max<size_t>(1, std::min<size_t>(threads * 4, size / (1 << 20)));
+	std::vector<const char*> bounds(chunk_count + 1);
+	bounds[0] = data;
+	bounds[chunk_count] = data + size;
+	for (size_t chunk = 1; chunk < chunk_count; chunk++)
+	{
+		const char* split = std::max(bounds[chunk - 1], data + size * chunk / chunk_count);
+		const char* line_end = (const char*)std::memchr(split, '\n', data + size - split);
+		bounds[chunk] = line_end ? line_end + 1 : data + size;
+	}
+
+	std::vector<ObjChunk> chunks(chunk_count);
+	std::atomic<size_t> next_chunk(0);
+	parallel_for(threads, threads, 1, [&](size_t, size_t)
+	{
+		for (size_t chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++)
+		{
+			parse_obj_chunk(bounds[chunk], bounds[chunk + 1], chunks[chunk]);
+		}
+	});
+
+	// 2. resolve indices to the whole file, now that each chunk's start counts are known
+	struct Counts { size_t position, uv, normal, corner; };
+	std::vector<Counts> starts(chunk_count + 1, Counts{ 0, 0, 0, 0 });
+	for (size_t chunk = 0; chunk < chunk_count; chunk++)
+	{
+		if (!chunks[chunk].error.empty())
+		{
+			std::cout << "ERROR::MESH_IMPORTER::OBJ_PARSE_FAILED\n" << path << ": " << chunks[chunk].error << std::endl;
+			return mesh;
+		}
+		starts[chunk + 1].position = starts[chunk].position + chunks[chunk].positions.size() / 3;
+		starts[chunk + 1].uv       = starts[chunk].uv + chunks[chunk].uvs.size() / 2;
+		starts[chunk + 1].normal   = starts[chunk].normal + chunks[chunk].normals.size() / 3;
+		starts[chunk + 1].corner   = starts[chunk].corner + chunks[chunk].corners.size();
+	}
+	const Counts totals = starts[chunk_count];
+	if (totals.corner == 0 || totals.position >= 0xFFFFFFFFu)
+	{
+		std::cout << "ERROR::MESH_IMPORTER::NO_TRIANGLES\n" << path << std::endl;
+		return mesh;
+	}
+
+	struct Key { uint32_t index[3]; };
+	std::vector<Key> keys(totals.corner);
+	std::vector<uint64_t> hashes(totals.corner);
+	std::atomic<bool> out_of_range(false);
+	parallel_for(chunk_count, threads, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t chunk = begin; chunk < end; chunk++)
+		{
+			const size_t chunk_start[3] = { starts[chunk].position, starts[chunk].uv, starts[chunk].normal };
+			const size_t limit[3] = { totals.position, totals.uv, totals.normal };
+			const std::vector<ObjCorner>& corners = chunks[chunk].corners;
+			for (size_t i = 0; i < corners.size(); i++)
+			{
+				Key& key = keys[starts[chunk].corner + i];
+				for (int component = 0; component < 3; component++)
+				{
+					key.index[component] = ~0u;
+					if (!(corners[i].present & (1 << component)))
+					{
+						continue;
+					}
+					int64_t index = corners[i].index[component];
+					if (corners[i].relative & (1 << component))
+					{
+						index += (int64_t)chunk_start[component];
+					}
+					if (index < 0 || (size_t)index >= limit[component])
+					{
+						out_of_range = true;
+						continue;
+					}
+					key.index[component] = (uint32_t)index;
+				}
+				hashes[starts[chunk].corner + i] = fnv1a(std::string_view((const char*)&key, sizeof(Key)));
+			}
+		}
+	});
+	if (out_of_range)
+	{
+		std::cout << "ERROR::MESH_IMPORTER::OBJ_INDEX_OUT_OF_RANGE\n" << path << std::endl;
+		return mesh;
+	}
+
+	// 3. one vertex per distinct position/uv/normal combination
+	std::vector<uint32_t> first;
+	deduplicate(hashes, threads, [&keys](size_t a, size_t b) { return std::memcmp(&keys[a], &keys[b], sizeof(Key)) == 0; },
+	            mesh.indices, first);
+
+	mesh.vertices.resize(first.size());
+	parallel_for(first.size(), threads, min_parallel_range, [&](size_t begin, size_t end)
+	{
+		// Attributes are read from the chunk that declared them
+		auto find_chunk = [&](size_t index, size_t Counts::*member)
+		{
+			size_t low = 0, high = chunk_count;
+			while (high - low > 1)
+			{
+				const size_t middle = (low + high) / 2;
+				(starts[middle].*member <= index ? low : high) = middle;
+			}
+			return low;
+		};
+		for (size_t v = begin; v < end; v++)
+		{
+			const Key& key = keys[first[v]];
+			ImportedVertex& vertex = mesh.vertices[v];
+			vertex = ImportedVertex();
+
+			size_t chunk = find_chunk(key.index[0], &Counts::position);
+			const float* position = &chunks[chunk].positions[(key.index[0] - starts[chunk].position) * 3];
+			vertex.position = glm::vec3(position[0], position[1], position[2]);
+			if (key.index[1] != ~0u)
+			{
+				chunk = find_chunk(key.index[1], &Counts::uv);
+				const float* uv = &chunks[chunk].uvs[(key.index[1] - starts[chunk].uv) * 2];
+				vertex.uv = glm::vec2(uv[0], uv[1]);
+			}
+			if (key.index[2] != ~0u)
+			{
+				chunk = find_chunk(key.index[2], &Counts::normal);
+				const float* normal = &chunks[chunk].normals[(key.index[2] - starts[chunk].normal) * 3];
+				vertex.normal = glm::vec3(normal[0], normal[1], normal[2]);
+			}
+		}
+	});
+
+	if (options.optimize)
+	{
+		optimize(mesh);
+	}
+	return mesh;
+}
+
+namespace
+{
+	// glTF
+	// ----
+
+	constexpr uint32_t glb_magic      = 0x46546C67; // "glTF"
+	constexpr uint32_t glb_chunk_json = 0x4E4F534A;
+	constexpr uint32_t glb_chunk_bin  = 0x004E4942;
+
+	struct GltfBuffers
+	{
+		std::deque<MappedFile> files;
+		std::deque<std::string> decoded;
+		std::vector<std::string_view> data;
+	};
+
+	std::string decode_uri(const std::string& uri)
+	{
+		std::string decoded;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size())
+			{
+				decoded += (char)std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+				i += 2;
+			}
+			else
+			{
+				decoded += uri[i];
+			}
+		}
+		return decoded;
+	}
+
+	bool decode_base64(std::string_view text, std::string& out)
+	{
+		uint32_t bits = 0;
+		int bit_count = 0;
+		for (char c : text)
+		{
+			int value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else if (c == '=') break;
+			else return false;
+
+			bits = (bits << 6) | (uint32_t)value;
+			bit_count += 6;
+			if (bit_count >= 8)
+			{
+				bit_count -= 8;
+				out += (char)((bits >> bit_count) & 0xFF);
+			}
+		}
+		return true;
+	}
+
+	bool load_buffers(const Json& json, const std::string& directory, std::string_view glb_bin,
+	                  GltfBuffers& buffers, std::string& error)
+	{
+		const Json& list = json["buffers"];
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			const Json& buffer = list[i];
+			const size_t length = (size_t)buffer["byteLength"].integer_or(0);
+			const std::string& uri = buffer["uri"].string_or_empty();
+			std::string_view data;
+
+			if (uri.empty())
+			{
+				// Only the first buffer of a .glb may refer to the binary chunk
+				data = glb_bin;
+			}
+			else if (uri.compare(0, 5, "data:") == 0)
+			{
+				const size_t comma = uri.find(";base64,");
+				buffers.decoded.emplace_back();
+				if (comma == std::string::npos ||
+					!decode_base64(std::string_view(uri).substr(comma + 8), buffers.decoded.back()))
+				{
+					error = "buffer " + std::to_string(i) + " has an unsupported data uri";
+					return false;
+				}
+				data = buffers.decoded.back();
+			}
+			else
+			{
+				buffers.files.emplace_back();
+				const std::string file_path = directory + decode_uri(uri);
+				if (!buffers.files.back().open(file_path.c_str()))
+				{
+					error = file_path + ": " + buffers.files.back().error();
+					return false;
+				}
+				data = buffers.files.back().view();
+			}
+
+			if (data.size() < length)
+			{
+				error = "buffer " + std::to_string(i) + " is shorter than its byteLength";
+				return false;
+			}
+			buffers.data.push_back(data.substr(0, length));
+		}
+		return true;
+	}
+
+	enum ComponentType
+	{
+		Byte = 5120, UnsignedByte = 5121, Short = 5122, UnsignedShort = 5123, UnsignedInt = 5125, Float = 5126
+	};
+
+	size_t component_size(int64_t type)
+	{
+		switch (type)
+		{
+		case Byte: case UnsignedByte: return 1;
+		case Short: case UnsignedShort: return 2;
+		case UnsignedInt: case Float: return 4;
+		default: return 0;
+		}
+	}
+
+	// Strided view of an accessor's elements inside a buffer
+	struct Accessor
+	{
+		const char* data = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		int64_t component_type = 0;
+		int components = 0;
+		bool normalized = false;
+
+		// Component as float, normalized integers are mapped to [0, 1] / [-1, 1]
+		float read(size_t element, int component) const
+		{
+			const char* p = data + element * stride + component * component_size(component_type);
+			switch (component_type)
+			{
+			case Float: { float v; std::memcpy(&v, p, 4); return v; }
+			case UnsignedByte: { const uint8_t v = (uint8_t)*p; return normalized ? v / 255.0f : (float)v; }
+			case Byte: { const int8_t v = (int8_t)*p; return normalized ? std::max(v / 127.0f, -1.0f) : (float)v; }
+			case UnsignedShort: { uint16_t v; std::memcpy(&v, p, 2); return normalized ? v / 65535.0f : (float)v; }
+			case Short: { int16_t v; std::memcpy(&v, p, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : (float)v; }
+			case UnsignedInt: { uint32_t v; std::memcpy(&v, p, 4); return (float)v; }
+			default: return 0.0f;
+			}
+		}
+
+		uint32_t read_index(size_t element) const
+		{
+			const char* p = data + element * stride;
+			switch (component_type)
+			{
+			case UnsignedByte: return (uint8_t)*p;
+			case UnsignedShort: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+			default: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+			}
+		}
+	};
+
+	bool load_accessor(const Json& json, const GltfBuffers& buffers, const Json& index, Accessor& accessor, std::string& error)
+	{
+		const Json& description = json["accessors"][(size_t)index.integer_or(-1)];
+		if (description.is_null())
+		{
+			error = "missing accessor";
+			return false;
+		}
+		if (description.has("sparse") || !description.has("bufferView"))
+		{
+			error = "sparse and buffer-less accessors are not supported";
+			return false;
+		}
+
+		const std::string& type = description["type"].string_or_empty();
+		accessor.components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+		accessor.component_type = description["componentType"].integer_or(0);
+		accessor.normalized = description["normalized"].boolean_or(false);
+		accessor.count = (size_t)description["count"].integer_or(0);
+		const size_t element_size = component_size(accessor.component_type) * accessor.components;
+		if (element_size == 0)
+		{
+			error = "unsupported accessor type " + type;
+			return false;
+		}
+
+		const Json& view = json["bufferViews"][(size_t)description["bufferView"].integer_or(-1)];
+		const size_t buffer = (size_t)view["buffer"].integer_or(-1);
+		if (view.is_null() || buffer >= buffers.data.size())
+		{
+			error = "accessor refers to a missing buffer";
+			return false;
+		}
+		const size_t offset = (size_t)view["byteOffset"].integer_or(0) + (size_t)description["byteOffset"].integer_or(0);
+		accessor.stride = (size_t)view["byteStride"].integer_or((int64_t)element_size);
+
+		// The last element has to end inside the view and the buffer
+		const size_t view_end = (size_t)view["byteOffset"].integer_or(0) + (size_t)view["byteLength"].integer_or(0);
+		const size_t needed = accessor.count == 0 ? offset : offset + accessor.stride * (accessor.count - 1) + element_size;
+		if (needed > view_end || view_end > buffers.data[buffer].size())
+		{
+			error = "accessor reads past the end of its buffer";
+			return false;
+		}
+		accessor.data = buffers.data[buffer].data() + offset;
+		return true;
+	}
+
+	// Column major 4x4
+	struct Matrix
+	{
+		float m[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	};
+
+	Matrix multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix result;
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+				}
+				result.m[column * 4 + row] = sum;
+			}
+		}
+		return result;
+	}
+
+	Matrix node_matrix(const Json& node)
+	{
+		Matrix matrix;
+		if (node["matrix"].size() == 16)
+		{
+			for (size_t i = 0; i < 16; i++)
+			{
+				matrix.m[i] = (float)node["matrix"][i].number_or(0.0);
+			}
+			return matrix;
+		}
+
+		// translation * rotation * scale
+		const Json& t = node["translation"];
+		const Json& r = node["rotation"];
+		const Json& s = node["scale"];
+		const float x = (float)r[0].number_or(0.0), y = (float)r[1].number_or(0.0);
+		const float z = (float)r[2].number_or(0.0), w = (float)r[3].number_or(1.0);
+		const float scale[3] = { (float)s[0].number_or(1.0), (float)s[1].number_or(1.0), (float)s[2].number_or(1.0) };
+		const float rotation[9] = {
+			1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+			2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+			2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y),
+		};
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				matrix.m[column * 4 + row] = rotation[column * 3 + row] * scale[column];
+			}
+			matrix.m[12 + column] = (float)t[column].number_or(0.0);
+		}
+		return matrix;
+	}
+
+	struct MeshInstance
+	{
+		size_t mesh;
+		Matrix world;
+	};
+
+	void collect_instances(const Json& json, size_t node_index, const Matrix& parent, int depth,
+	                       std::vector<MeshInstance>& instances)
+	{
+		const Json& node = json["nodes"][node_index];
+		if (node.is_null() || depth > 64) // depth also stops cycles in broken files
+		{
+			return;
+		}
+		const Matrix world = multiply(parent, node_matrix(node));
+		if (node.has("mesh"))
+		{
+			instances.push_back({ (size_t)node["mesh"].integer_or(0), world });
+		}
+		const Json& children = node["children"];
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			collect_instances(json, (size_t)children[i].integer_or(-1), world, depth + 1, instances);
+		}
+	}
+
+	struct Primitive
+	{
+		Accessor positions, normals, uvs, indices;
+		bool has_normals = false, has_uvs = false, has_indices = false;
+		Matrix world;
+		float normal_matrix[9]; // cofactors of the upper 3x3, column major
+		bool flip_winding = false;
+		size_t first_vertex = 0, first_index = 0, index_count = 0;
+	};
+}
+
+ImportedMesh import_gltf(const std::string& path, const ImportOptions& options)
+{
+	ImportedMesh mesh;
+	MappedFile file;
+	if (!file.open(path.c_str()))
+	{
+		std::cout << "ERROR::MESH_IMPORTER::FILE_NOT_SUCCESSFULLY_READ\n" << path << ": " << file.error() << std::endl;
+		return mesh;
+	}
+	const unsigned int threads = worker_count(options.threads);
+
+	// 1. JSON, from the first chunk of a .glb or the whole .gltf
+	std::string_view text = file.view();
+	std::string_view glb_bin;
+	uint32_t header[3] = {};
+	if (file.size() >= 12)
+	{
+		std::memcpy(header, file.data(), 12);
+	}
+	if (header[0] == glb_magic)
+	{
+		text = std::string_view();
+		for (size_t offset = 12; offset + 8 <= file.size();)
+		{
+			uint32_t chunk[2];
+			std::memcpy(chunk, file.data() + offset, 8);
+			const std::string_view content = file.view().substr(offset + 8, chunk[0]);
+			if (chunk[1] == glb_chunk_json && text.empty())
+			{
+				text = content;
+			}
+			else if (chunk[1] == glb_chunk_bin && glb_bin.empty())
+			{
+				glb_bin = content;
+			}
+			offset += 8 + ((size_t)chunk[0] + 3) / 4 * 4;
+		}
+	}
+
+	std::string error;
+	const Json json = Json::parse(text, error);
+	GltfBuffers buffers;
+	if (!error.empty() || !load_buffers(json, directory_of(path), glb_bin, buffers, error))
+	{
+		std::cout << "ERROR::MESH_IMPORTER::GLTF_LOAD_FAILED\n" << path << ": " << error << std::endl;
+		return mesh;
+	}
+
+	// 2. flatten the scene into mesh instances with world transforms
+	std::vector<MeshInstance> instances;
+	const Json& scene = json["scenes"][(size_t)json["scene"].integer_or(0)];
+	if (!scene.is_null())
+	{
+		for (size_t i = 0; i < scene["nodes"].size(); i++)
+		{
+			collect_instances(json, (size_t)scene["nodes"][i].integer_or(-1), Matrix(), 0, instances);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < json["meshes"].size(); i++)
+		{
+			instances.push_back({ i, Matrix() });
+		}
+	}
+
+	// 3. find every triangle primitive and where its data goes in the output
+	std::vector<Primitive> primitives;
+	size_t vertex_total = 0, index_total = 0, skipped = 0;
+	for (const MeshInstance& instance : instances)
+	{
+		const Json& list = json["meshes"][instance.mesh]["primitives"];
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			const Json& description = list[i];
+			if (description["mode"].integer_or(4) != 4)
+			{
+				skipped++;
+				continue;
+			}
+
+			Primitive primitive;
+			const Json& attributes = description["attributes"];
+			bool loaded = load_accessor(json, buffers, attributes["POSITION"], primitive.positions, error);
+			if (loaded && attributes.has("NORMAL"))
+			{
+				loaded = load_accessor(json, buffers, attributes["NORMAL"], primitive.normals, error);
+				primitive.has_normals = true;
+			}
+			if (loaded && attributes.has("TEXCOORD_0"))
+			{
+				loaded = load_accessor(json, buffers, attributes["TEXCOORD_0"], primitive.uvs, error);
+				primitive.has_uvs = true;
+			}
+			if (loaded && description.has("indices"))
+			{
+				loaded = load_accessor(json, buffers, description["indices"], primitive.indices, error);
+				primitive.has_indices = true;
+			}
+			if (loaded && (primitive.positions.components != 3 ||
+				(primitive.has_normals && (primitive.normals.components != 3 || primitive.normals.count != primitive.positions.count)) ||
+				(primitive.has_uvs && (primitive.uvs.components != 2 || primitive.uvs.count != primitive.positions.count)) ||
+				(primitive.has_indices && primitive.indices.components != 1)))
+			{
+				error = "primitive attributes don't match";
+				loaded = false;
+			}
+			if (!loaded)
+			{
+				std::cout << "ERROR::MESH_IMPORTER::GLTF_LOAD_FAILED\n" << path << ": mesh " << instance.mesh << ": " << error << std::endl;
+				return mesh;
+			}
+
+			// Normals go through the inverse transpose, the cofactor matrix is that times the
+			// determinant. Mirroring transforms also flip the triangle winding.
+			primitive.world = instance.world;
+			const float* m = instance.world.m;
+			float* n = primitive.normal_matrix;
+			n[0] = m[5] * m[10] - m[9] * m[6];
+			n[1] = m[8] * m[6] - m[4] * m[10];
+			n[2] = m[4] * m[9] - m[8] * m[5];
+			n[3] = m[9] * m[2] - m[1] * m[10];
+			n[4] = m[0] * m[10] - m[8] * m[2];
+			n[5] = m[8] * m[1] - m[0] * m[9];
+			n[6] = m[1] * m[6] - m[5] * m[2];
+			n[7] = m[4] * m[2] - m[0] * m[6];
+			n[8] = m[0] * m[5] - m[4] * m[1];
+			const float determinant = m[0] * n[0] + m[4] * n[3] + m[8] * n[6];
+			primitive.flip_winding = determinant < 0.0f;
+			if (primitive.flip_winding)
+			{
+				for (int k = 0; k < 9; k++)
+				{
+					n[k] = -n[k];
+				}
+			}
+
+			primitive.index_count = primitive.has_indices ? primitive.indices.count : primitive.positions.count;
+			primitive.index_count -= primitive.index_count % 3;
+			primitive.first_vertex = vertex_total;
+			primitive.first_index = index_total;
+			vertex_total += primitive.positions.count;
+			index_total += primitive.index_count;
+			primitives.push_back(primitive);
+		}
+	}
+	if (skipped > 0)
+	{
+		std::cout << "WARNING::MESH_IMPORTER::SKIPPED_NON_TRIANGLE_PRIMITIVES " << skipped << "\n" << path << std::endl;
+	}
+	if (index_total == 0 || vertex_total >= 0xFFFFFFFFu)
+	{
+		std::cout << "ERROR::MESH_IMPORTER::NO_TRIANGLES\n" << path << std::endl;
+		return mesh;
+	}
+
+	// 4. convert straight from the mapped buffers into the output arrays, vertices are
+	// merged in place afterwards so they're only held once
+	std::vector<ImportedVertex>& vertices = mesh.vertices;
+	vertices.resize(vertex_total);
+	mesh.indices.resize(index_total);
+	std::atomic<bool> out_of_range(false);
+	for (const Primitive& primitive : primitives)
+	{
+		parallel_for(primitive.positions.count, threads, min_parallel_range, [&](size_t begin, size_t end)
+		{
+			const float* m = primitive.world.m;
+			const float* n = primitive.normal_matrix;
+			for (size_t v = begin; v < end; v++)
+			{
+				ImportedVertex& vertex = vertices[primitive.first_vertex + v];
+				vertex = ImportedVertex();
+				const float x = primitive.positions.read(v, 0), y = primitive.positions.read(v, 1), z = primitive.positions.read(v, 2);
+				vertex.position = glm::vec3(m[0] * x + m[4] * y + m[8] * z + m[12],
+				                            m[1] * x + m[5] * y + m[9] * z + m[13],
+				                            m[2] * x + m[6] * y + m[10] * z + m[14]);
+				if (primitive.has_normals)
+				{
+					const float a = primitive.normals.read(v, 0), b = primitive.normals.read(v, 1), c = primitive.normals.read(v, 2);
+					float normal[3] = { n[0] * a + n[3] * b + n[6] * c, n[1] * a + n[4] * b + n[7] * c, n[2] * a + n[5] * b + n[8] * c };
+					const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+					const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+					vertex.normal = glm::vec3(normal[0] * scale, normal[1] * scale, normal[2] * scale);
+				}
+				if (primitive.has_uvs)
+				{
+					vertex.uv = glm::vec2(primitive.uvs.read(v, 0), primitive.uvs.read(v, 1));
+				}
+			}
+		});
+
+		parallel_for(primitive.index_count / 3, threads, min_parallel_range, [&](size_t begin, size_t end)
+		{
+			for (size_t triangle = begin; triangle < end; triangle++)
+			{
+				uint32_t corners[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					const size_t element = triangle * 3 + k;
+					corners[k] = primitive.has_indices ? primitive.indices.read_index(element) : (uint32_t)element;
+					if (corners[k] >= primitive.positions.count)
+					{
+						out_of_range = true;
+						corners[k] = 0;
+					}
+					corners[k] += (uint32_t)primitive.first_vertex;
+				}
+				if (primitive.flip_winding)
+				{
+					std::swap(corners[1], corners[2]);
+				}
+				std::memcpy(&mesh.indices[primitive.first_index + triangle * 3], corners, sizeof(corners));
+			}
+		});
+	}
+	if (out_of_range)
+	{
+		std::cout << "ERROR::MESH_IMPORTER::GLTF_INDEX_OUT_OF_RANGE\n" << path << std::endl;
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		return mesh;
+	}
+
+	// 5. merge identical vertices, exporters often split them per primitive or face
+	std::vector<uint64_t> hashes(vertex_total);
+	parallel_for(vertex_total, threads, min_parallel_range, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			hashes[v] = fnv1a(std::string_view((const char*)&vertices[v], sizeof(ImportedVertex)));
+		}
+	});
+	std::vector<uint32_t> remap, first;
+	deduplicate(hashes, threads,
+	            [&vertices](size_t a, size_t b) { return std::memcmp(&vertices[a], &vertices[b], sizeof(ImportedVertex)) == 0; },
+	            remap, first);
+
+	// Ids follow first occurrence, so first[v] >= v and increasing: moving front to back only
+	// reads vertices that haven't been overwritten. Serial, as threads would read each others' targets.
+	for (size_t v = 0; v < first.size(); v++)
+	{
+		if (first[v] != v)
+		{
+			vertices[v] = vertices[first[v]];
+		}
+	}
+	vertices.resize(first.size());
+	parallel_for(index_total, threads, min_parallel_range, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			mesh.indices[i] = remap[mesh.indices[i]];
+		}
+	});
+
+	if (options.optimize)
+	{
+		optimize(mesh);
+	}
+	return mesh;
+}
+
+ImportedMesh import_mesh(const std::string& path, const ImportOptions& options)
+{
+	if (ends_with(path, ".obj"))
+	{
+		return import_obj(path, options);
+	}
+	if (ends_with(path, ".gltf") || ends_with(path, ".glb"))
+	{
+		return import_gltf(path, options);
+	}
+	std::cout << "ERROR::MESH_IMPORTER::UNKNOWN_FORMAT\n" << path << std::endl;
+	return ImportedMesh();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VertexLayout.h"
+
+
+// Loads triangle meshes from OBJ and glTF 2.0 (.gltf with .bin or data: buffers, and .glb).
+// Files are memory mapped and parsed in place by worker threads, the only copy made is the
+// final vertex and index arrays, ready for GeometryArena::add or quantize_vertices.
+// Identical vertices are merged through a hash, then the index order is optimized
+// (MeshOptimizer.h) unless disabled.
+//
+//	ImportedMesh mesh = import_mesh("assets/sponza.glb");
+//	GeometryArena::Mesh sponza = arena.add(mesh.vertices.data(), (uint32_t)mesh.vertices.size(),
+//	                                       mesh.indices.data(), (uint32_t)mesh.indices.size());
+struct ImportedVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal; // zero if the file has none
+	glm::vec2 uv;
+};
+
+template <>
+struct VertexLayout<ImportedVertex>
+{
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(ImportedVertex, position, 0),
+		VERTEX_ATTRIBUTE(ImportedVertex, normal, 1),
+		VERTEX_ATTRIBUTE(ImportedVertex, uv, 2),
+	};
+};
+
+struct ImportedMesh
+{
+	std::vector<ImportedVertex> vertices;
+	std::vector<uint32_t> indices; // triangle list
+
+	bool valid() const { return !indices.empty(); }
+};
+
+struct ImportOptions
+{
+	unsigned int threads = 0; // 0 uses every hardware thread
+	bool optimize = true;     // vertex cache, overdraw and fetch order
+};
+
+// Picks the format from the extension (.obj, .gltf, .glb). glTF scenes are flattened,
+// node transforms are applied to the vertices. On failure an error is printed and the
+// returned mesh is empty.
+ImportedMesh import_mesh(const std::string& path, const ImportOptions& options = {});
+
+ImportedMesh import_obj(const std::string& path, const ImportOptions& options = {});
+ImportedMesh import_gltf(const std::string& path, const ImportOptions& options = {});
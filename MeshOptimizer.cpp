@@ -0,0 +1,335 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Triangles using each vertex, as offsets into one flat list
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;   // vertex_count + 1
+		std::vector<uint32_t> triangles;
+
+		Adjacency(const uint32_t* indices, size_t index_count, size_t vertex_count)
+			: offsets(vertex_count + 1, 0), triangles(index_count)
+		{
+			for (size_t i = 0; i < index_count; i++)
+			{
+				offsets[indices[i] + 1]++;
+			}
+			for (size_t v = 0; v < vertex_count; v++)
+			{
+				offsets[v + 1] += offsets[v];
+			}
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < index_count; i++)
+			{
+				triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+			}
+		}
+	};
+
+	struct Vec3
+	{
+		float x, y, z;
+	};
+
+	Vec3 position_of(const float* positions, size_t stride, uint32_t vertex)
+	{
+		const float* p = (const float*)((const char*)positions + vertex * stride);
+		return Vec3{ p[0], p[1], p[2] };
+	}
+}
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, size_t cache_size)
+{
+	VertexCacheStats stats;
+	if (index_count < 3 || vertex_count == 0)
+	{
+		return stats;
+	}
+
+	// FIFO: a vertex is cached if it entered less than cache_size misses ago
+	std::vector<size_t> entered(vertex_count, 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < index_count; i++)
+	{
+		const uint32_t vertex = indices[i];
+		if (entered[vertex] == 0 || misses + 1 - entered[vertex] > cache_size)
+		{
+			misses++;
+			entered[vertex] = misses;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(index_count / 3);
+	stats.atvr = (float)misses / (float)vertex_count;
+	return stats;
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+	const size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || vertex_count == 0)
+	{
+		return;
+	}
+
+	const Adjacency adjacency(indices, triangle_count * 3, vertex_count);
+	std::vector<uint32_t> live(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+	{
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<size_t> cache_time(vertex_count, 0);
+	std::vector<uint32_t> dead_end;    // recently used vertices, fallback when the fan runs dry
+	std::vector<uint32_t> candidates;
+
+	const size_t cache_size = vertex_cache_size;
+	size_t time = cache_size + 1;
+	size_t cursor = 0;                 // scan position for the last resort fallback
+	int64_t fan = 0;
+
+	while (fan >= 0)
+	{
+		candidates.clear();
+
+		// Emit every remaining triangle around the fan vertex
+		for (uint32_t t = adjacency.offsets[fan]; t < adjacency.offsets[fan + 1]; t++)
+		{
+			const uint32_t triangle = adjacency.triangles[t];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+			emitted[triangle] = true;
+
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				dead_end.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				if (time - cache_time[vertex] > cache_size)
+				{
+					cache_time[vertex] = time;
+					time++;
+				}
+			}
+		}
+
+		// Next fan: the candidate that stays in the cache the longest once its triangles are emitted
+		fan = -1;
+		size_t best_priority = 0;
+		for (uint32_t vertex : candidates)
+		{
+			if (live[vertex] == 0)
+			{
+				continue;
+			}
+			size_t priority = 0;
+			if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size)
+			{
+				priority = time - cache_time[vertex];
+			}
+			if (fan < 0 || priority > best_priority)
+			{
+				best_priority = priority;
+				fan = vertex;
+			}
+		}
+
+		// Dead end: back to recently touched vertices, then anything left
+		while (fan < 0 && !dead_end.empty())
+		{
+			const uint32_t vertex = dead_end.back();
+			dead_end.pop_back();
+			if (live[vertex] > 0)
+			{
+				fan = vertex;
+			}
+		}
+		while (fan < 0 && cursor < vertex_count)
+		{
+			if (live[cursor] > 0)
+			{
+				fan = (int64_t)cursor;
+			}
+			cursor++;
+		}
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t stride,
+                       size_t vertex_count, float threshold)
+{
+	const size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || vertex_count == 0)
+	{
+		return;
+	}
+
+	// Cut a new cluster wherever the current one, simulated from a cold cache, is within
+	// threshold of the overall ACMR. Drawing clusters in any order then costs at most that.
+	const float acmr = analyze_vertex_cache(indices, triangle_count * 3, vertex_count).acmr;
+	std::vector<size_t> cluster_starts(1, 0);
+	{
+		std::vector<size_t> entered(vertex_count, 0);
+		size_t misses = 0;
+		size_t cluster_first_miss = 0;
+		size_t cluster_start = 0;
+		for (size_t triangle = 0; triangle < triangle_count; triangle++)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				if (entered[vertex] <= cluster_first_miss || misses + 1 - entered[vertex] > vertex_cache_size)
+				{
+					misses++;
+					entered[vertex] = misses;
+				}
+			}
+
+			const size_t cluster_size = triangle + 1 - cluster_start;
+			if (triangle + 1 < triangle_count &&
+				(float)(misses - cluster_first_miss) <= acmr * threshold * (float)cluster_size)
+			{
+				cluster_starts.push_back(triangle + 1);
+				cluster_start      = triangle + 1;
+				cluster_first_miss = misses;
+			}
+		}
+	}
+	if (cluster_starts.size() < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid and normal per cluster
+	struct Cluster
+	{
+		size_t first, count;
+		Vec3 centroid, normal;
+		float area;
+		float sort_key;
+	};
+	std::vector<Cluster> clusters;
+	Vec3 mesh_centroid = { 0.0f, 0.0f, 0.0f };
+	float mesh_area = 0.0f;
+	for (size_t c = 0; c < cluster_starts.size(); c++)
+	{
+		Cluster cluster = {};
+		cluster.first = cluster_starts[c];
+		cluster.count = (c + 1 < cluster_starts.size() ? cluster_starts[c + 1] : triangle_count) - cluster.first;
+
+		for (size_t triangle = cluster.first; triangle < cluster.first + cluster.count; triangle++)
+		{
+			const Vec3 a = position_of(positions, stride, indices[triangle * 3 + 0]);
+			const Vec3 b = position_of(positions, stride, indices[triangle * 3 + 1]);
+			const Vec3 c3 = position_of(positions, stride, indices[triangle * 3 + 2]);
+			const Vec3 ab = { b.x - a.x, b.y - a.y, b.z - a.z };
+			const Vec3 ac = { c3.x - a.x, c3.y - a.y, c3.z - a.z };
+			const Vec3 cross = { ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+			const float area = std::sqrt(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+
+			cluster.centroid.x += (a.x + b.x + c3.x) / 3.0f * area;
+			cluster.centroid.y += (a.y + b.y + c3.y) / 3.0f * area;
+			cluster.centroid.z += (a.z + b.z + c3.z) / 3.0f * area;
+			cluster.normal.x += cross.x;
+			cluster.normal.y += cross.y;
+			cluster.normal.z += cross.z;
+			cluster.area += area;
+		}
+
+		mesh_centroid.x += cluster.centroid.x;
+		mesh_centroid.y += cluster.centroid.y;
+		mesh_centroid.z += cluster.centroid.z;
+		mesh_area += cluster.area;
+		if (cluster.area > 0.0f)
+		{
+			cluster.centroid.x /= cluster.area;
+			cluster.centroid.y /= cluster.area;
+			cluster.centroid.z /= cluster.area;
+		}
+		clusters.push_back(cluster);
+	}
+	if (mesh_area > 0.0f)
+	{
+		mesh_centroid.x /= mesh_area;
+		mesh_centroid.y /= mesh_area;
+		mesh_centroid.z /= mesh_area;
+	}
+
+	// Clusters far out along their own normal occlude the rest, draw them first
+	for (Cluster& cluster : clusters)
+	{
+		const float length = std::sqrt(cluster.normal.x * cluster.normal.x + cluster.normal.y * cluster.normal.y +
+		                               cluster.normal.z * cluster.normal.z);
+		const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		cluster.sort_key = ((cluster.centroid.x - mesh_centroid.x) * cluster.normal.x +
+		                    (cluster.centroid.y - mesh_centroid.y) * cluster.normal.y +
+		                    (cluster.centroid.z - mesh_centroid.z) * cluster.normal.z) * scale;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(),
+	                 [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+	for (const Cluster& cluster : clusters)
+	{
+		output.insert(output.end(), indices + cluster.first * 3, indices + (cluster.first + cluster.count) * 3);
+	}
+	std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t optimize_vertex_fetch(void* vertices, size_t stride, size_t vertex_count, uint32_t* indices, size_t index_count)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertex_count, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < index_count; i++)
+	{
+		uint32_t& target = remap[indices[i]];
+		if (target == unused)
+		{
+			target = next++;
+		}
+		indices[i] = target;
+	}
+
+	std::vector<char> original((const char*)vertices, (const char*)vertices + vertex_count * stride);
+	for (size_t v = 0; v < vertex_count; v++)
+	{
+		if (remap[v] != unused)
+		{
+			std::memcpy((char*)vertices + remap[v] * stride, original.data() + v * stride, stride);
+		}
+	}
+	return next;
+}
+
+IndexData compact_indices(const uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+	IndexData data;
+	data.count = index_count;
+	if (vertex_count <= 0x10000)
+	{
+		data.type = GL_UNSIGNED_SHORT;
+		data.indices16.assign(indices, indices + index_count);
+	}
+	else
+	{
+		data.type = GL_UNSIGNED_INT;
+		data.indices32.assign(indices, indices + index_count);
+	}
+	return data;
+}
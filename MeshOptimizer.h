@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Reorders indexed triangle lists for the GPU, run once on imported geometry.
+// The usual order is:
+//
+//	optimize_vertex_cache(indices, index_count, vertex_count);
+//	optimize_overdraw(indices, index_count, &vertices[0].position.x, sizeof(Vertex), vertex_count);
+//	vertex_count = optimize_vertex_fetch(vertices, sizeof(Vertex), vertex_count, indices, index_count);
+//	IndexData packed = compact_indices(indices, index_count, vertex_count);
+//
+// Indices past the last whole triangle (index_count not a multiple of 3) are left as they are.
+
+// Vertex cache size used for the reordering, small enough for any post-transform cache
+constexpr size_t vertex_cache_size = 16;
+
+struct VertexCacheStats
+{
+	float acmr = 0.0f; // average cache misses per triangle, 0.5 is ideal and 3 is the worst
+	float atvr = 0.0f; // average transforms per vertex, 1 is ideal
+};
+
+// Simulate a FIFO post-transform cache over the index list
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                                      size_t cache_size = vertex_cache_size);
+
+// Tipsify (Sander et al. 2007): reorder triangles in place so vertices are reused while still cached.
+// Linear in the index count.
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+// Reorder clusters of the cache optimized order so triangles facing outwards come first,
+// which lets early depth testing reject more of what is drawn after them. threshold is the
+// ACMR each cluster may lose to get more (smaller) clusters, 1.05 allows 5%.
+// positions points to the first vertex's xyz floats, stride is the vertex size in bytes.
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t stride,
+                       size_t vertex_count, float threshold = 1.05f);
+
+// Reorder the vertices by first use so fetches walk memory linearly. Unreferenced vertices
+// are dropped, returns the new vertex count. Indices are remapped in place.
+size_t optimize_vertex_fetch(void* vertices, size_t stride, size_t vertex_count, uint32_t* indices, size_t index_count);
+
+// Index list in the narrowest type that holds every vertex index
+struct IndexData
+{
+	GLenum type = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	size_t count = 0;
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+
+	const void* data() const { return type == GL_UNSIGNED_SHORT ? (const void*)indices16.data() : (const void*)indices32.data(); }
+	GLsizeiptr bytes() const { return (GLsizeiptr)(count * (type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t))); }
+};
+
+// 16 bit indices when vertex_count allows it, halves the index memory
+IndexData compact_indices(const uint32_t* indices, size_t index_count, size_t vertex_count);
@@ -0,0 +1,338 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+	struct Vec3
+	{
+		double x, y, z;
+	};
+
+	Vec3 subtract(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vec3 cross(const Vec3& a, const Vec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	double dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	// Symmetric 4x4 for the sum of squared distances to a set of planes
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+
+		static Quadric plane(const Vec3& n, double d)
+		{
+			Quadric q;
+			q.a00 = n.x * n.x; q.a01 = n.x * n.y; q.a02 = n.x * n.z;
+			q.a11 = n.y * n.y; q.a12 = n.y * n.z; q.a22 = n.z * n.z;
+			q.b0 = n.x * d; q.b1 = n.y * d; q.b2 = n.z * d;
+			q.c = d * d;
+			return q;
+		}
+
+		void add(const Quadric& o)
+		{
+			a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+			b0 += o.b0; b1 += o.b1; b2 += o.b2;
+			c += o.c;
+		}
+
+		double error(const Vec3& p) const
+		{
+			const double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+				+ 2 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+				+ 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			return e > 0 ? e : 0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from, to;
+		double cost;
+	};
+}
+
+std::vector<uint32_t> simplify_mesh(const uint32_t* indices, size_t index_count, const float* positions, size_t stride,
+                                    size_t vertex_count, size_t target_index_count, float max_error, float* error)
+{
+	std::vector<uint32_t> result(indices, indices + index_count - index_count % 3);
+	if (error)
+	{
+		*error = 0.0f;
+	}
+	if (result.empty() || vertex_count == 0)
+	{
+		return result;
+	}
+
+	auto position = [&](uint32_t v)
+	{
+		const float* p = (const float*)((const char*)positions + v * stride);
+		return Vec3{ p[0], p[1], p[2] };
+	};
+
+	// 1. vertices sharing a position are one corner of the surface, canonical is the first of them
+	std::vector<uint32_t> order(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		order[v] = v;
+	}
+	auto less = [&](uint32_t a, uint32_t b)
+	{
+		const float* pa = (const float*)((const char*)positions + a * stride);
+		const float* pb = (const float*)((const char*)positions + b * stride);
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		if (pa[2] != pb[2]) return pa[2] < pb[2];
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), less);
+	std::vector<uint32_t> canonical(vertex_count);
+	std::vector<uint32_t> wedges(vertex_count, 0);
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		const bool same = i > 0 && std::memcmp((const char*)positions + order[i] * stride,
+		                                       (const char*)positions + order[i - 1] * stride, 3 * sizeof(float)) == 0;
+		canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+		wedges[canonical[order[i]]]++;
+	}
+
+	// 2. lock seams, open borders and non-manifold edges
+	std::vector<uint8_t> locked(vertex_count, 0);
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		locked[v] = wedges[canonical[v]] > 1;
+	}
+	{
+		std::vector<uint64_t> edges;
+		edges.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				const uint64_t a = canonical[result[i + k]], b = canonical[result[i + (k + 1) % 3]];
+				edges.push_back(a < b ? a << 32 | b : b << 32 | a);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i;
+			while (j < edges.size() && edges[j] == edges[i])
+			{
+				j++;
+			}
+			if (j - i != 2)
+			{
+				locked[edges[i] >> 32] = 1;
+				locked[edges[i] & 0xFFFFFFFFu] = 1;
+			}
+			i = j;
+		}
+		for (uint32_t v = 0; v < vertex_count; v++)
+		{
+			locked[v] |= locked[canonical[v]];
+		}
+	}
+
+	// 3. plane quadrics per canonical vertex
+	std::vector<Quadric> quadrics(vertex_count);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const Vec3 a = position(result[i]), b = position(result[i + 1]), c = position(result[i + 2]);
+		Vec3 n = cross(subtract(b, a), subtract(c, a));
+		const double length = std::sqrt(dot(n, n));
+		if (length == 0)
+		{
+			continue;
+		}
+		n = { n.x / length, n.y / length, n.z / length };
+		const Quadric q = Quadric::plane(n, -dot(n, a));
+		for (size_t k = 0; k < 3; k++)
+		{
+			quadrics[canonical[result[i + k]]].add(q);
+		}
+	}
+
+	// 4. passes of the cheapest independent collapses until the target is met
+	const double max_cost = (double)max_error * max_error;
+	double reached = 0.0;
+	std::vector<uint32_t> offsets(vertex_count + 1), triangles, fill;
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> touched(vertex_count);
+	std::vector<uint32_t> remap(vertex_count);
+
+	while (result.size() > target_index_count)
+	{
+		const size_t triangle_count = result.size() / 3;
+
+		// Triangles around each vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t v : result)
+		{
+			offsets[v + 1]++;
+		}
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			offsets[v + 1] += offsets[v];
+		}
+		triangles.resize(result.size());
+		fill.assign(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			triangles[fill[result[i]]++] = (uint32_t)(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+				if (canonical[a] == canonical[b])
+				{
+					continue;
+				}
+				Quadric q = quadrics[canonical[a]];
+				q.add(quadrics[canonical[b]]);
+				if (!locked[a])
+				{
+					collapses.push_back({ a, b, q.error(position(b)) });
+				}
+				if (!locked[b])
+				{
+					collapses.push_back({ b, a, q.error(position(a)) });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		// Each collapse removes about two triangles
+		const size_t wanted = (result.size() - target_index_count) / 6 + 1;
+		size_t applied = 0;
+		std::fill(touched.begin(), touched.end(), 0);
+		for (uint32_t v = 0; v < vertex_count; v++)
+		{
+			remap[v] = v;
+		}
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (applied >= wanted || collapse.cost > max_cost)
+			{
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			// Reject collapses that would flip a remaining triangle
+			const Vec3 target = position(collapse.to);
+			bool flips = false;
+			for (uint32_t t = offsets[collapse.from]; t < offsets[collapse.from + 1] && !flips; t++)
+			{
+				const uint32_t* corner = &result[triangles[t] * 3];
+				if (corner[0] == collapse.to || corner[1] == collapse.to || corner[2] == collapse.to)
+				{
+					continue; // degenerates and goes away
+				}
+				Vec3 p[3], moved[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					p[k] = position(corner[k]);
+					moved[k] = corner[k] == collapse.from ? target : p[k];
+				}
+				const Vec3 before = cross(subtract(p[1], p[0]), subtract(p[2], p[0]));
+				const Vec3 after = cross(subtract(moved[1], moved[0]), subtract(moved[2], moved[0]));
+				flips = dot(before, after) <= 0.0;
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			// Freeze the neighbourhood for the rest of this pass, the costs around it are stale now
+			for (uint32_t t = offsets[collapse.from]; t < offsets[collapse.from + 1]; t++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					touched[result[triangles[t] * 3 + k]] = 1;
+				}
+			}
+			touched[collapse.to] = 1;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[canonical[collapse.to]].add(quadrics[canonical[collapse.from]]);
+			reached = std::max(reached, collapse.cost);
+			applied++;
+		}
+		if (applied == 0)
+		{
+			break;
+		}
+
+		// Rewrite and drop the triangles that collapsed
+		size_t write = 0;
+		for (size_t i = 0; i < triangle_count; i++)
+		{
+			const uint32_t a = remap[result[i * 3]], b = remap[result[i * 3 + 1]], c = remap[result[i * 3 + 2]];
+			if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+			{
+				continue;
+			}
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (error)
+	{
+		*error = (float)std::sqrt(reached);
+	}
+	return result;
+}
+
+std::vector<MeshLod> build_lod_chain(std::vector<uint32_t>& indices, const float* positions, size_t stride,
+                                     size_t vertex_count, const LodChainOptions& options)
+{
+	std::vector<MeshLod> lods;
+	lods.push_back({ 0, (uint32_t)indices.size(), 0, 0, 0.0f, 0 });
+
+	while (lods.size() < options.max_lods)
+	{
+		const MeshLod previous = lods.back();
+		if (previous.index_count / 3 < options.min_triangles * 2)
+		{
+			break;
+		}
+
+		// Simplify the previous level, cheaper than starting from the full mesh every time
+		const size_t target = (size_t)(previous.index_count / 3 * options.reduction) * 3;
+		float error = 0.0f;
+		std::vector<uint32_t> simplified = simplify_mesh(indices.data() + previous.first_index, previous.index_count,
+		                                                 positions, stride, vertex_count, target, options.max_error, &error);
+
+		// Not worth a level if it barely got smaller
+		if (simplified.empty() || simplified.size() > previous.index_count * 9 / 10)
+		{
+			break;
+		}
+		optimize_vertex_cache(simplified.data(), simplified.size(), vertex_count);
+
+		MeshLod lod = {};
+		lod.first_index = (uint32_t)indices.size();
+		lod.index_count = (uint32_t)simplified.size();
+		lod.error = std::max(previous.error, error);
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lods.push_back(lod);
+	}
+	return lods;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshFile.h"
+
+
+// Quadric error metric simplification (Garland & Heckbert 1997) by edge collapse onto
+// existing vertices. Only indices change, so every level of detail shares one vertex buffer
+// and a LOD is just another range of the index buffer (MeshLod).
+//
+// Vertices on open borders and on attribute seams (several vertices at one position, e.g.
+// UV island edges) stay put, so LODs don't crack or smear textures across seams.
+
+// Simplify towards target_index_count without exceeding max_error (object space distance).
+// positions points to the first vertex's xyz floats, stride is the vertex size in bytes.
+// error receives the error reached, the input is not modified.
+std::vector<uint32_t> simplify_mesh(const uint32_t* indices, size_t index_count, const float* positions, size_t stride,
+                                    size_t vertex_count, size_t target_index_count, float max_error, float* error = nullptr);
+
+struct LodChainOptions
+{
+	size_t max_lods = 6;          // including the full mesh
+	float reduction = 0.5f;       // triangle ratio between consecutive levels
+	float max_error = 1e30f;      // stop once a level would need more error than this
+	size_t min_triangles = 64;    // stop below this many triangles
+};
+
+// Append successively simplified copies of indices[0, index_count) to indices, each one
+// cache optimized. Returns the levels, finest first; meshlet fields are left zero.
+std::vector<MeshLod> build_lod_chain(std::vector<uint32_t>& indices, const float* positions, size_t stride,
+                                     size_t vertex_count, const LodChainOptions& options = {});
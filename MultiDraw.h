@@ -0,0 +1,211 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "Instancing.h"
+#include "StreamBuffer.h"
+
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+	GLuint count;          // indices
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;  // first instance in the instance stream, gl_BaseInstance in the shader
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "Indirect commands are 5 tightly packed ints");
+
+// Collects instances of arena meshes per bucket (usually one per material/program) and
+// submits each bucket with a single glMultiDrawElementsIndirect. The first draw() of a
+// frame sorts everything by bucket and mesh, streams the instances and writes one command
+// per mesh, so the driver validates state once per bucket instead of once per mesh.
+//
+// Per draw data comes from the instance stream: each command's base instance points at its
+// slice, so instance attributes (see InstanceData) are fetched per draw without rebinding.
+// Shaders that index their own buffers can use gl_BaseInstance + gl_InstanceID, or gl_DrawID
+// for the command within the bucket.
+//
+//	MultiDrawBatcher<> batcher(arena, 100000, 4096);
+//	for (...) batcher.add(stone_material, rock, instance);
+//	stone_shader.use();
+//	batcher.draw(stone_material);
+//	...
+//	batcher.end_frame();
+template <typename Instance = InstanceData>
+class MultiDrawBatcher
+{
+public:
+	// max_instances and max_draws (distinct bucket/mesh pairs) per frame,
+	// the arena's VAO reads instances at binding_index
+	MultiDrawBatcher(GeometryArena& arena, size_t max_instances, size_t max_draws, GLuint binding_index = 1)
+		: arena(arena),
+		  stream((GLsizeiptr)(max_instances * sizeof(Instance) + max_draws * sizeof(DrawElementsIndirectCommand) + 16)),
+		  binding(binding_index)
+	{
+		arena.vao.instance_buffer<Instance>(binding, stream.id);
+	}
+
+	MultiDrawBatcher(const MultiDrawBatcher&) = delete;
+	MultiDrawBatcher& operator=(const MultiDrawBatcher&) = delete;
+
+	void add(uint32_t bucket, GeometryArena::Mesh mesh, const Instance& instance)
+	{
+		if (mesh == GeometryArena::no_mesh)
+		{
+			return;
+		}
+		if (built)
+		{
+			std::cout << "ERROR::MULTI_DRAW::ADD_AFTER_DRAW\n" << "Call end_frame() before adding the next frame" << std::endl;
+			return;
+		}
+		keys.push_back({ (uint64_t)bucket << 32 | mesh, (uint32_t)instances.size() });
+		instances.push_back(instance);
+	}
+
+	// Draw everything added to bucket this frame with the current program
+	void draw(uint32_t bucket)
+	{
+		if (!built)
+		{
+			build();
+		}
+		auto it = std::lower_bound(buckets.begin(), buckets.end(), bucket,
+		                           [](const BucketRange& range, uint32_t key) { return range.bucket < key; });
+		if (it == buckets.end() || it->bucket != bucket)
+		{
+			return;
+		}
+
+		arena.vao.bind();
+		GLState::get().bind_buffer(GL_DRAW_INDIRECT_BUFFER, stream.id);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, arena.index_type(),
+			(const void*)(uintptr_t)(command_offset + it->first_command * sizeof(DrawElementsIndirectCommand)),
+			(GLsizei)it->command_count, (GLsizei)sizeof(DrawElementsIndirectCommand));
+		calls++;
+	}
+
+	// Fence this frame's stream region and start collecting the next frame
+	void end_frame()
+	{
+		if (built)
+		{
+			stream.end_frame();
+		}
+		last_calls = calls;
+		last_commands = command_total;
+		calls = 0;
+		command_total = 0;
+		built = false;
+		keys.clear();
+		instances.clear();
+		buckets.clear();
+	}
+
+	// glMultiDrawElementsIndirect calls and commands they contained in the last frame
+	size_t draw_calls() const { return last_calls; }
+	size_t draw_commands() const { return last_commands; }
+
+	// Delete the GL objects now, e.g. before the context is destroyed
+	void release() { stream.release(); }
+
+private:
+	struct SortKey
+	{
+		uint64_t key;   // bucket << 32 | mesh
+		uint32_t index; // into instances, keeps add order within a mesh
+		bool operator<(const SortKey& other) const
+		{
+			return key != other.key ? key < other.key : index < other.index;
+		}
+	};
+
+	struct BucketRange
+	{
+		uint32_t bucket;
+		size_t first_command;
+		size_t command_count;
+	};
+
+	// Sort the frame's instances by bucket and mesh and write them and the commands to the stream
+	void build()
+	{
+		built = true;
+		stream.begin_frame();
+		if (keys.empty())
+		{
+			return;
+		}
+		std::sort(keys.begin(), keys.end());
+
+		size_t command_count = 1;
+		for (size_t i = 1; i < keys.size(); i++)
+		{
+			command_count += keys[i].key != keys[i - 1].key;
+		}
+
+		GLintptr instance_offset = 0;
+		Instance* mapped_instances = stream.allocate<Instance>(instances.size(), instance_offset);
+		DrawElementsIndirectCommand* commands = stream.allocate<DrawElementsIndirectCommand>(command_count, command_offset);
+		if (!mapped_instances || !commands)
+		{
+			std::cout << "ERROR::MULTI_DRAW::TOO_MANY_DRAWS\n" << instances.size() << " instances in "
+				<< command_count << " draws" << std::endl;
+			return;
+		}
+		glVertexArrayVertexBuffer(arena.vao.id, binding, stream.id, instance_offset, (GLsizei)sizeof(Instance));
+
+		for (size_t i = 0; i < keys.size();)
+		{
+			const uint64_t key = keys[i].key;
+			const uint32_t bucket = (uint32_t)(key >> 32);
+			const GeometryArena::Mesh mesh = (GeometryArena::Mesh)key;
+
+			const size_t first = i;
+			for (; i < keys.size() && keys[i].key == key; i++)
+			{
+				mapped_instances[i] = instances[keys[i].index];
+			}
+
+			const GeometryArena::DrawRange range = arena.range(mesh);
+			if (range.index_count == 0)
+			{
+				continue;
+			}
+			if (buckets.empty() || buckets.back().bucket != bucket)
+			{
+				buckets.push_back({ bucket, command_total, 0 });
+			}
+			commands[command_total] = { (GLuint)range.index_count, (GLuint)(i - first), range.first_index,
+			                            range.base_vertex, (GLuint)first };
+			command_total++;
+			buckets.back().command_count++;
+		}
+	}
+
+	GeometryArena& arena;
+	StreamBuffer stream;
+	GLuint binding;
+
+	std::vector<SortKey> keys;
+	std::vector<Instance> instances;  // in add order
+	std::vector<BucketRange> buckets; // this frame's, sorted by bucket
+	GLintptr command_offset = 0;
+	size_t command_total = 0;
+	bool built = false;
+
+	size_t calls = 0;
+	size_t last_calls = 0;
+	size_t last_commands = 0;
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// Threads to use when the caller passes 0: one per hardware thread
+inline unsigned int worker_count(unsigned int requested = 0)
+{
+	if (requested != 0)
+	{
+		return requested;
+	}
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Split [0, count) into up to threads contiguous ranges of at least min_range items and
+// call fn(begin, end) for each, the last range on the calling thread. Returns when all are done.
+template <typename Function>
+void parallel_for(size_t count, unsigned int threads, size_t min_range, Function&& fn)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	min_range = std::max<size_t>(min_range, 1);
+	const size_t ranges = std::max<size_t>(1, std::min<size_t>(threads, (count + min_range - 1) / min_range));
+	const size_t range_size = (count + ranges - 1) / ranges;
+
+	std::vector<std::future<void>> workers;
+	size_t begin = 0;
+	for (size_t range = 0; range + 1 < ranges && begin < count; range++)
+	{
+		const size_t end = std::min(count, begin + range_size);
+		workers.push_back(std::async(std::launch::async, [&fn, begin, end]() { fn(begin, end); }));
+		begin = end;
+	}
+	if (begin < count)
+	{
+		fn(begin, count);
+	}
+	for (std::future<void>& worker : workers)
+	{
+		worker.get();
+	}
+}
+
+// Threads that stay alive between calls, for work issued every frame where starting threads
+// like parallel_for does would cost about as much as the work itself. The calling thread
+// takes ranges too. One job at a time: parallel_for() must not be called from inside a job
+// or from two threads at once.
+class WorkerPool
+{
+public:
+	// threads includes the caller (0 = one per hardware thread), so threads - 1 are started
+	explicit WorkerPool(unsigned int threads = 0)
+	{
+		const unsigned int count = worker_count(threads);
+		for (unsigned int i = 1; i < count; i++)
+		{
+			workers.emplace_back([this]() { work(); });
+		}
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+	// Same contract as the free parallel_for, with at most size() threads
+	template <typename Function>
+	void parallel_for(size_t count, unsigned int threads, size_t min_range, Function&& fn)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		min_range = std::max<size_t>(min_range, 1);
+		const size_t ranges = std::max<size_t>(1, std::min<size_t>(std::min(threads, size()), (count + min_range - 1) / min_range));
+		if (ranges == 1)
+		{
+			fn(0, count);
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		using Callable = std::remove_reference_t<Function>;
+		job_context = (void*)std::addressof(fn);
+		job_call = [](void* context, size_t begin, size_t end) { (*static_cast<Callable*>(context))(begin, end); };
+		job_count = count;
+		job_range_size = (count + ranges - 1) / ranges;
+		job_ranges = (count + job_range_size - 1) / job_range_size;
+		next_range = 0;
+		finished = 0;
+		lock.unlock();
+		wake.notify_all();
+
+		lock.lock();
+		while (next_range < job_ranges)
+		{
+			run_range(lock);
+		}
+		done.wait(lock, [this]() { return finished == job_ranges; });
+		// Late workers find nothing left to claim
+		job_ranges = 0;
+		next_range = 0;
+	}
+
+private:
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this]() { return stopping || next_range < job_ranges; });
+			if (stopping)
+			{
+				return;
+			}
+			run_range(lock);
+		}
+	}
+
+	// Claims happen under the lock, so a range is always run with the job it belongs to
+	void run_range(std::unique_lock<std::mutex>& lock)
+	{
+		const size_t begin = next_range++ * job_range_size;
+		const size_t end = std::min(job_count, begin + job_range_size);
+		void* context = job_context;
+		void (*call)(void*, size_t, size_t) = job_call;
+		lock.unlock();
+		call(context, begin, end);
+		lock.lock();
+		if (++finished == job_ranges)
+		{
+			done.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+
+	void* job_context = nullptr;
+	void (*job_call)(void*, size_t, size_t) = nullptr;
+	size_t job_count = 0;
+	size_t job_range_size = 0;
+	size_t job_ranges = 0;
+	size_t next_range = 0;
+	size_t finished = 0;
+};
@@ -0,0 +1,187 @@
+#include "ProgramCache.h"
+
+namespace
+{
+	constexpr uint32_t cache_magic = 0x42505347; // "GSPB"
+
+	// Strings are hashed with their length so neighbouring pieces can't shift into each other
+	uint64_t hash_string(std::string_view data, uint64_t hash)
+	{
+		return fnv1a((uint64_t)data.size(), fnv1a(data, hash));
+	}
+
+	std::string_view gl_string(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return value ? std::string_view((const char*)value) : std::string_view();
+	}
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t format;
+		uint64_t key;
+		uint32_t length;
+		uint32_t reserved;
+	};
+}
+
+ProgramCache::ProgramCache(std::string directory)
+	: directory(std::move(directory))
+{
+}
+
+uint64_t ProgramCache::driver_hash()
+{
+	uint64_t hash = fnv1a_offset;
+	hash = hash_string(gl_string(GL_VENDOR), hash);
+	hash = hash_string(gl_string(GL_RENDERER), hash);
+	hash = hash_string(gl_string(GL_VERSION), hash);
+	return hash;
+}
+
+uint64_t ProgramCache::make_key(const std::vector<std::string_view>& sources, std::string_view defines)
+{
+	return make_key(driver_hash(), sources, defines);
+}
+
+uint64_t ProgramCache::make_key(uint64_t driver, const std::vector<std::string_view>& sources, std::string_view defines)
+{
+	uint64_t hash = hash_string(defines, driver);
+	for (std::string_view source : sources)
+	{
+		hash = hash_string(source, hash);
+	}
+	return hash;
+}
+
+std::filesystem::path ProgramCache::path_for(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return std::filesystem::path(directory) / name;
+}
+
+unsigned int ProgramCache::load(uint64_t key) const
+{
+	Binary binary;
+	if (!read(key, binary))
+	{
+		return 0;
+	}
+	unsigned int program = create(binary);
+	if (program == 0)
+	{
+		// Driver may reject binaries it can no longer use, fall back to source
+		std::error_code ec;
+		std::filesystem::remove(path_for(key), ec);
+	}
+	return program;
+}
+
+void ProgramCache::store(uint64_t key, unsigned int program) const
+{
+	Binary binary;
+	if (retrieve(program, binary))
+	{
+		write(key, binary);
+	}
+}
+
+bool ProgramCache::read(uint64_t key, Binary& binary) const
+{
+	const std::filesystem::path path = path_for(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	// A short read (truncated entry) counts as corrupt, the stream fails and the data is dropped
+	CacheHeader header{};
+	binary.data.clear();
+	if (file.read((char*)&header, sizeof(header)) && header.magic == cache_magic && header.key == key)
+	{
+		binary.data.resize(header.length);
+		if (!file.read(binary.data.data(), header.length))
+		{
+			binary.data.clear();
+		}
+	}
+	file.close();
+
+	if (binary.data.empty())
+	{
+		std::cout << "WARNING::PROGRAM_CACHE::CORRUPT_ENTRY " << path.string() << std::endl;
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+		return false;
+	}
+	binary.format = (GLenum)header.format;
+	return true;
+}
+
+void ProgramCache::write(uint64_t key, const Binary& binary) const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	// Write to a temporary file then rename so a crash never leaves a half written entry.
+	// The name is per thread, two writers of the same key never share one.
+	const std::filesystem::path path = path_for(key);
+	std::filesystem::path temp_path = path;
+	temp_path += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "WARNING::PROGRAM_CACHE::WRITE_FAILED " << temp_path.string() << std::endl;
+			return;
+		}
+		CacheHeader header{ cache_magic, binary.format, key, (uint32_t)binary.data.size(), 0 };
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data.data(), (std::streamsize)binary.data.size());
+	}
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+	}
+}
+
+unsigned int ProgramCache::create(const Binary& binary)
+{
+	unsigned int program = glCreateProgram();
+	glProgramBinary(program, binary.format, binary.data.data(), (GLsizei)binary.data.size());
+
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+bool ProgramCache::retrieve(unsigned int program, Binary& binary)
+{
+	int formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats == 0)
+	{
+		return false; // Driver doesn't support retrieving binaries
+	}
+
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return false;
+	}
+
+	binary.data.resize(length);
+	glGetProgramBinary(program, length, &length, &binary.format, binary.data.data());
+	binary.data.resize(length);
+	return length > 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include "Hash.h"
+
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// Entries are keyed by the shader sources, the defines used to build them and the
+// driver's vendor/renderer/version strings so a driver update invalidates them.
+class ProgramCache
+{
+public:
+	// Directory is created on first store if it doesn't exist
+	explicit ProgramCache(std::string directory);
+
+	// Driver binary of a linked program
+	struct Binary
+	{
+		GLenum format = 0;
+		std::vector<char> data;
+	};
+
+	// Hash sources, defines and the current context's driver strings into a cache key
+	static uint64_t make_key(const std::vector<std::string_view>& sources, std::string_view defines = {});
+
+	// Same with the driver strings hashed beforehand (driver_hash() on the context's thread),
+	// so keys can be made on threads without a context
+	static uint64_t make_key(uint64_t driver, const std::vector<std::string_view>& sources,
+	                         std::string_view defines = {});
+	static uint64_t driver_hash();
+
+	// Create a program from a cached binary, returns 0 on a miss or if the driver rejects it
+	unsigned int load(uint64_t key) const;
+
+	// Save the binary of a successfully linked program
+	void store(uint64_t key, unsigned int program) const;
+
+	// load() and store() split into their file and GL halves, so the disk access can run on
+	// another thread while only create() and retrieve() stay on the context's thread.
+	// read() and write() don't touch GL and can be called from any thread.
+
+	// Read an entry, false on a miss; corrupt entries are deleted
+	bool read(uint64_t key, Binary& binary) const;
+	void write(uint64_t key, const Binary& binary) const;
+
+	// Program from a binary, 0 if the driver rejects it
+	static unsigned int create(const Binary& binary);
+
+	// Binary of a linked program, false if the driver can't provide one
+	static bool retrieve(unsigned int program, Binary& binary);
+
+private:
+	std::string directory;
+
+	std::filesystem::path path_for(uint64_t key) const;
+};
@@ -0,0 +1,264 @@
+#include "RangeAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t lowest_bit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return (uint32_t)__builtin_ctz(value);
+#endif
+	}
+
+	uint32_t highest_bit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return 31 - (uint32_t)__builtin_clz(value);
+#endif
+	}
+
+	// Bin of a block: first level is the power of two, second level splits it in 8.
+	// Sizes below 8 all live in first level 0.
+	void bin_of(uint32_t size, uint32_t& first, uint32_t& second)
+	{
+		if (size < 8)
+		{
+			first  = 0;
+			second = size;
+			return;
+		}
+		const uint32_t msb = highest_bit(size);
+		first  = msb - 2;
+		second = (size >> (msb - 3)) ^ 8;
+	}
+}
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+	: total(capacity), available(capacity)
+{
+	for (auto& heads : free_heads)
+	{
+		for (uint32_t& head : heads)
+		{
+			head = invalid;
+		}
+	}
+
+	if (capacity > 0)
+	{
+		nodes.push_back({ 0, capacity, invalid, invalid, invalid, invalid, invalid, false });
+		last_block = 0;
+		insert_free(0);
+	}
+}
+
+uint32_t RangeAllocator::new_node()
+{
+	if (!spare_nodes.empty())
+	{
+		uint32_t node = spare_nodes.back();
+		spare_nodes.pop_back();
+		return node;
+	}
+	nodes.push_back(Node());
+	return (uint32_t)nodes.size() - 1;
+}
+
+void RangeAllocator::insert_free(uint32_t index)
+{
+	Node& node = nodes[index];
+	uint32_t first, second;
+	bin_of(node.size, first, second);
+
+	node.used          = false;
+	node.previous_free = invalid;
+	node.next_free     = free_heads[first][second];
+	if (node.next_free != invalid)
+	{
+		nodes[node.next_free].previous_free = index;
+	}
+	free_heads[first][second] = index;
+
+	first_level_bitmap          |= 1u << first;
+	second_level_bitmap[first]  |= 1u << second;
+}
+
+void RangeAllocator::remove_free(uint32_t index)
+{
+	Node& node = nodes[index];
+	uint32_t first, second;
+	bin_of(node.size, first, second);
+
+	if (node.previous_free != invalid)
+	{
+		nodes[node.previous_free].next_free = node.next_free;
+	}
+	else
+	{
+		free_heads[first][second] = node.next_free;
+	}
+	if (node.next_free != invalid)
+	{
+		nodes[node.next_free].previous_free = node.previous_free;
+	}
+
+	if (free_heads[first][second] == invalid)
+	{
+		second_level_bitmap[first] &= ~(1u << second);
+		if (second_level_bitmap[first] == 0)
+		{
+			first_level_bitmap &= ~(1u << first);
+		}
+	}
+}
+
+uint32_t RangeAllocator::find_free(uint32_t size) const
+{
+	// Round up to the next bin so any block found there is large enough
+	uint32_t rounded = size;
+	if (size >= 8)
+	{
+		const uint32_t step = (1u << (highest_bit(size) - 3)) - 1;
+		if (rounded > ~0u - step)
+		{
+			return invalid;
+		}
+		rounded += step;
+	}
+
+	uint32_t first, second;
+	bin_of(rounded, first, second);
+	if (first >= first_level_count)
+	{
+		return invalid;
+	}
+
+	uint32_t second_map = second_level_bitmap[first] & (~0u << second);
+	if (second_map == 0)
+	{
+		const uint32_t first_map = first + 1 < first_level_count ? first_level_bitmap & (~0u << (first + 1)) : 0;
+		if (first_map == 0)
+		{
+			return invalid;
+		}
+		first      = lowest_bit(first_map);
+		second_map = second_level_bitmap[first];
+	}
+	second = lowest_bit(second_map);
+	return free_heads[first][second];
+}
+
+RangeAllocator::Range RangeAllocator::allocate(uint32_t size, uint32_t owner)
+{
+	if (size == 0)
+	{
+		return Range();
+	}
+
+	const uint32_t index = find_free(size);
+	if (index == invalid)
+	{
+		return Range();
+	}
+	remove_free(index);
+
+	// Split off what isn't needed and give it back to the free lists
+	if (nodes[index].size > size)
+	{
+		const uint32_t rest = new_node();
+		Node& block = nodes[index];
+		nodes[rest] = { block.offset + size, block.size - size, invalid, index, block.next_block, invalid, invalid, false };
+		if (block.next_block != invalid)
+		{
+			nodes[block.next_block].previous_block = rest;
+		}
+		else
+		{
+			last_block = rest;
+		}
+		block.next_block = rest;
+		block.size       = size;
+		insert_free(rest);
+	}
+
+	Node& block = nodes[index];
+	block.used  = true;
+	block.owner = owner;
+	available  -= size;
+	return Range{ block.offset, block.size, index, owner };
+}
+
+void RangeAllocator::free(const Range& range)
+{
+	if (range.node == invalid || range.node >= nodes.size() || !nodes[range.node].used)
+	{
+		return;
+	}
+
+	uint32_t index = range.node;
+	available += nodes[index].size;
+
+	// Merge with the following block
+	const uint32_t next = nodes[index].next_block;
+	if (next != invalid && !nodes[next].used)
+	{
+		remove_free(next);
+		nodes[index].size      += nodes[next].size;
+		nodes[index].next_block = nodes[next].next_block;
+		if (nodes[next].next_block != invalid)
+		{
+			nodes[nodes[next].next_block].previous_block = index;
+		}
+		else
+		{
+			last_block = index;
+		}
+		spare_nodes.push_back(next);
+	}
+
+	// Merge into the preceding block
+	const uint32_t previous = nodes[index].previous_block;
+	if (previous != invalid && !nodes[previous].used)
+	{
+		remove_free(previous);
+		nodes[previous].size      += nodes[index].size;
+		nodes[previous].next_block = nodes[index].next_block;
+		if (nodes[index].next_block != invalid)
+		{
+			nodes[nodes[index].next_block].previous_block = previous;
+		}
+		else
+		{
+			last_block = previous;
+		}
+		spare_nodes.push_back(index);
+		index = previous;
+	}
+
+	nodes[index].owner = invalid;
+	insert_free(index);
+}
+
+RangeAllocator::Range RangeAllocator::last_allocation() const
+{
+	for (uint32_t index = last_block; index != invalid; index = nodes[index].previous_block)
+	{
+		const Node& node = nodes[index];
+		if (node.used)
+		{
+			return Range{ node.offset, node.size, index, node.owner };
+		}
+	}
+	return Range();
+}
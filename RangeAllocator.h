@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+// Two-level segregated fit (TLSF) allocator for ranges of a fixed size resource,
+// e.g. vertices in one big vertex buffer. Only offsets are handed out, the memory
+// itself lives elsewhere. Allocation and free are O(1), freed neighbours are merged.
+class RangeAllocator
+{
+public:
+	static constexpr uint32_t invalid = ~0u;
+
+	struct Range
+	{
+		uint32_t offset = invalid;
+		uint32_t size   = 0;
+		uint32_t node   = invalid; // internal handle used by free()
+		uint32_t owner  = invalid; // caller's id for the range
+
+		bool valid() const { return offset != invalid; }
+	};
+
+	explicit RangeAllocator(uint32_t capacity);
+
+	// Returns an invalid range if no free block is large enough or size is 0
+	Range allocate(uint32_t size, uint32_t owner = invalid);
+	void free(const Range& range);
+
+	// Allocated range with the highest offset (invalid if nothing is allocated)
+	Range last_allocation() const;
+
+	uint32_t capacity() const { return total; }
+	uint32_t free_space() const { return available; }
+
+private:
+	static constexpr uint32_t second_level_bits  = 3;
+	static constexpr uint32_t second_level_count = 1 << second_level_bits;
+	static constexpr uint32_t first_level_count  = 32;
+
+	struct Node
+	{
+		uint32_t offset;
+		uint32_t size;
+		uint32_t owner;
+		uint32_t previous_block; // neighbours by address
+		uint32_t next_block;
+		uint32_t previous_free;  // neighbours in the free list of its bin
+		uint32_t next_free;
+		bool used;
+	};
+
+	uint32_t total;
+	uint32_t available;
+	std::vector<Node> nodes;
+	std::vector<uint32_t> spare_nodes;
+	uint32_t last_block = invalid;
+
+	uint32_t first_level_bitmap = 0;
+	uint32_t second_level_bitmap[first_level_count] = {};
+	uint32_t free_heads[first_level_count][second_level_count];
+
+	uint32_t new_node();
+	void insert_free(uint32_t node);
+	void remove_free(uint32_t node);
+	uint32_t find_free(uint32_t size) const;
+};
@@ -0,0 +1,197 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+
+namespace
+{
+	// Top bits of a non negative float, the bit pattern of those orders like the value
+	// and spreads precision evenly over each power of two
+	uint64_t quantize_depth(float depth, unsigned int bits)
+	{
+		if (!(depth > 0.0f))
+		{
+			return 0;
+		}
+		uint32_t pattern;
+		std::memcpy(&pattern, &depth, sizeof(pattern));
+		return pattern >> (31 - bits);
+	}
+}
+
+uint64_t RenderQueue::opaque_key(uint32_t pass, uint32_t program, uint32_t material, uint32_t mesh, float depth)
+{
+	return (uint64_t)(pass & 0xF) << 60 |
+	       (uint64_t)(program & 0x3FF) << 49 |
+	       (uint64_t)(material & 0x3FFF) << 35 |
+	       (uint64_t)(mesh & 0x7FFF) << 20 |
+	       quantize_depth(depth, 20);
+}
+
+uint64_t RenderQueue::translucent_key(uint32_t pass, uint32_t program, uint32_t material, uint32_t mesh, float depth)
+{
+	// Farther draws get smaller keys and go first
+	return (uint64_t)(pass & 0xF) << 60 |
+	       (uint64_t)1 << 59 |
+	       (0xFFFFFF - quantize_depth(depth, 24)) << 35 |
+	       (uint64_t)(program & 0x3FF) << 25 |
+	       (uint64_t)(material & 0x3FFF) << 11 |
+	       (uint64_t)(mesh & 0x7FF);
+}
+
+RenderQueue::Draw RenderQueue::arena_draw(GLuint program, const GeometryArena& arena, GeometryArena::Mesh mesh)
+{
+	const GeometryArena::DrawRange range = arena.range(mesh);
+	Draw draw;
+	draw.program      = program;
+	draw.vao          = arena.vao.id;
+	draw.index_type   = arena.index_type();
+	draw.index_count  = range.index_count;
+	draw.index_offset = (uintptr_t)range.first_index * arena.index_size();
+	draw.base_vertex  = range.base_vertex;
+	return draw;
+}
+
+void RenderQueue::reserve(size_t draw_count)
+{
+	draws.reserve(draw_count);
+	items.reserve(draw_count);
+	scratch.reserve(draw_count);
+}
+
+void RenderQueue::submit(uint64_t key, const Draw& draw)
+{
+	if (draw.index_count <= 0 || draw.instance_count <= 0)
+	{
+		return;
+	}
+	items.push_back({ key, (uint32_t)draws.size() });
+	draws.push_back(draw);
+}
+
+void RenderQueue::flush()
+{
+	Stats stats;
+	stats.draws = (uint32_t)items.size();
+	stats.sort_passes = radix_sort(items, scratch);
+
+	GLState& state = GLState::get();
+	GLuint program = 0;
+	GLuint vao = 0;
+	uint32_t material = 0;
+	bool first = true;
+	bool translucent = false;
+
+	for (const SortItem& item : items)
+	{
+		const Draw& draw = draws[item.index];
+
+		const bool blended = is_translucent(item.key);
+		if (first || blended != translucent)
+		{
+			state.set_blend(blended);
+			if (blended)
+			{
+				state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			state.depth_mask(!blended);
+			translucent = blended;
+		}
+
+		const bool program_changed = first || draw.program != program;
+		if (program_changed)
+		{
+			state.use_program(draw.program);
+			program = draw.program;
+			stats.program_changes++;
+		}
+		if (program_changed || draw.material != material)
+		{
+			if (bind_material)
+			{
+				bind_material(draw.material);
+			}
+			material = draw.material;
+			stats.material_changes++;
+		}
+		if (first || draw.vao != vao)
+		{
+			state.bind_vertex_array(draw.vao);
+			vao = draw.vao;
+			stats.vao_changes++;
+		}
+		first = false;
+
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, draw.index_count, draw.index_type,
+			(const void*)draw.index_offset, draw.instance_count, draw.base_vertex, draw.base_instance);
+	}
+
+	// Leave the default opaque state for whatever draws after the queue
+	if (translucent)
+	{
+		state.set_blend(false);
+		state.depth_mask(true);
+	}
+
+	draws.clear();
+	items.clear();
+	last_stats = stats;
+}
+
+uint32_t radix_sort(std::vector<RenderQueue::SortItem>& items, std::vector<RenderQueue::SortItem>& scratch)
+{
+	const size_t count = items.size();
+	if (count < 2)
+	{
+		return 0;
+	}
+
+	// Histograms of all 8 digits in one read of the keys
+	std::vector<uint32_t> histograms(8 * 256, 0);
+	for (const RenderQueue::SortItem& item : items)
+	{
+		for (unsigned int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit * 256 + ((item.key >> (digit * 8)) & 0xFF)]++;
+		}
+	}
+
+	scratch.resize(count);
+	RenderQueue::SortItem* source = items.data();
+	RenderQueue::SortItem* destination = scratch.data();
+	uint32_t passes = 0;
+
+	for (unsigned int digit = 0; digit < 8; digit++)
+	{
+		uint32_t* histogram = &histograms[digit * 256];
+		const unsigned int shift = digit * 8;
+
+		// All keys share this digit, the pass wouldn't change the order
+		if (histogram[(source[0].key >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// Counts to starting offsets
+		uint32_t offset = 0;
+		for (unsigned int bucket = 0; bucket < 256; bucket++)
+		{
+			const uint32_t bucket_count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucket_count;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+		}
+		std::swap(source, destination);
+		passes++;
+	}
+
+	// An odd number of passes leaves the result in scratch
+	if (source != items.data())
+	{
+		items.swap(scratch);
+	}
+	return passes;
+}
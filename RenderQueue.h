@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "GeometryArena.h"
+#include "GLState.h"
+
+
+// Draws submitted in any order during the frame and issued sorted by a 64 bit key, so
+// program, material and VAO changes happen as rarely as possible. Keys are sorted with an
+// LSD radix sort, linear in the number of draws.
+//
+// Key layout, most significant first:
+//	opaque:      pass 4 | 0 | program 10 | material 14 | mesh 15 | depth 20 (front to back)
+//	translucent: pass 4 | 1 | depth 24 (back to front) | program 10 | material 14 | mesh 11
+// Opaque draws are grouped by state and roughly front to back inside a group for early-z,
+// translucent ones have to blend in order, state only breaks ties. Ids are truncated to
+// their field, which only affects how well draws are grouped, never what is drawn.
+//
+//	queue.submit(RenderQueue::opaque_key(0, shader.id, material, mesh, depth), RenderQueue::arena_draw(shader.id, arena, mesh));
+//	...
+//	queue.flush(); // once all draws of the frame are in
+class RenderQueue
+{
+public:
+	// Everything needed to issue one glDrawElementsInstancedBaseVertexBaseInstance
+	struct Draw
+	{
+		GLuint program = 0;
+		GLuint vao = 0;
+		uint32_t material = 0;       // handed to the material callback whenever it changes
+		GLenum index_type = GL_UNSIGNED_INT;
+		GLsizei index_count = 0;
+		uintptr_t index_offset = 0;  // bytes into the VAO's element buffer
+		GLint base_vertex = 0;
+		GLsizei instance_count = 1;
+		GLuint base_instance = 0;
+	};
+
+	struct Stats
+	{
+		uint32_t draws = 0;
+		uint32_t program_changes = 0;
+		uint32_t material_changes = 0;
+		uint32_t vao_changes = 0;
+		uint32_t sort_passes = 0; // radix passes that weren't skipped
+	};
+
+	// Item the radix sort orders, index points into the submitted draws
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// depth is the view space distance (>= 0), later passes draw after earlier ones
+	static uint64_t opaque_key(uint32_t pass, uint32_t program, uint32_t material, uint32_t mesh, float depth);
+	static uint64_t translucent_key(uint32_t pass, uint32_t program, uint32_t material, uint32_t mesh, float depth);
+	static bool is_translucent(uint64_t key) { return (key >> 59) & 1; }
+
+	// Draw of one arena mesh, binds the arena's VAO
+	static Draw arena_draw(GLuint program, const GeometryArena& arena, GeometryArena::Mesh mesh);
+
+	// Called with the material id whenever it or the program changes, after the program is in use
+	void set_material_callback(std::function<void(uint32_t material)> callback) { bind_material = std::move(callback); }
+
+	void reserve(size_t draw_count);
+	void submit(uint64_t key, const Draw& draw);
+
+	// Sort everything submitted since the last flush, issue it in order and empty the queue.
+	// Translucent draws are blended (source alpha) without depth writes.
+	void flush();
+
+	size_t size() const { return draws.size(); }
+	const Stats& stats() const { return last_stats; }
+
+private:
+	std::vector<Draw> draws;
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	std::function<void(uint32_t)> bind_material;
+	Stats last_stats;
+};
+
+// Stable LSD radix sort of items by key, 8 bits per pass. Passes where every key has the
+// same digit are skipped, usually most of them as high fields rarely vary within a frame.
+// scratch is resized as needed, the sorted result always ends up in items.
+// Returns the number of passes that moved data.
+uint32_t radix_sort(std::vector<RenderQueue::SortItem>& items, std::vector<RenderQueue::SortItem>& scratch);
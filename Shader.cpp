@@ -1,87 +1,114 @@
 #include "Shader.h"
 
-Shader::Shader(const char* vertex_path, const char* fragment_path)
+Shader::Shader(const char* vertex_path, const char* fragment_path, const ProgramCache* cache, const ShaderDefines& defines)
 {
-	// 1. retrieve the vertex/fragment source code from file path
-	std::string vertex_code;
-	std::string fragment_code;
-	std::ifstream vertex_shader_file;
-	std::ifstream fragment_shader_file;
+	// 1. map and preprocess the vertex/fragment source code from file path
+	ShaderSource vertex_source;
+	ShaderSource fragment_source;
+	if (!vertex_source.load(vertex_path, defines) || !fragment_source.load(fragment_path, defines))
+	{
+		id = 0;
+		return;
+	}
+	build(vertex_source, fragment_source, cache);
+}
 
-	// Ensure if stream objects can throw exceptions
-	vertex_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fragment_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
+Shader::Shader(const ShaderLibrary& library, const char* vertex_name, const char* fragment_name,
+               const ProgramCache* cache, const ShaderDefines& defines)
+{
+	// 1. preprocess the embedded vertex/fragment source code, no file access
+	ShaderSource vertex_source;
+	ShaderSource fragment_source;
+	if (!vertex_source.load(library, vertex_name, defines) || !fragment_source.load(library, fragment_name, defines))
 	{
-		// open files
-		vertex_shader_file.open(vertex_path);
-		fragment_shader_file.open(fragment_path);
-		std::stringstream vertex_shader_stream, fragment_shader_stream;
+		id = 0;
+		return;
+	}
+	build(vertex_source, fragment_source, cache);
+}
 
-		// read file's buffer contents into streams
-		vertex_shader_stream << vertex_shader_file.rdbuf();
-		fragment_shader_stream << fragment_shader_file.rdbuf();
+Shader::Shader(const SpirvModule& vertex_module, const SpirvModule& fragment_module,
+               const SpecializationConstants& constants)
+{
+	if (vertex_module.size() == 0 || fragment_module.size() == 0 || !spirv_supported())
+	{
+		id = 0;
+		return;
+	}
 
-		// close file handlers
-		vertex_shader_file.close();
-		fragment_shader_file.close();
+	// Specializing with a constant the stage doesn't declare fails, each stage gets its own
+	unsigned int vertex   = create_shader(GL_VERTEX_SHADER, vertex_module, constants.declared_by(vertex_module));
+	unsigned int fragment = create_shader(GL_FRAGMENT_SHADER, fragment_module, constants.declared_by(fragment_module));
+	check_compile(vertex, "VERTEX");
+	check_compile(fragment, "FRAGMENT");
 
-		// convert stream into string
-		vertex_code   = vertex_shader_stream.str();
-		fragment_code = fragment_shader_stream.str();
+	id = glCreateProgram();
+	glAttachShader(id, vertex);
+	glAttachShader(id, fragment);
+	glLinkProgram(id);
+	if (check_link(id))
+	{
+		// Only modules with debug names report uniform names, locations are explicit in SPIR-V anyway
+		load_uniforms();
+	}
+	else
+	{
+		glDeleteProgram(id);
+		id = 0;
 	}
-	catch (std::ifstream::failure e)
+
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+}
+
+void Shader::build(const ShaderSource& vertex_source, const ShaderSource& fragment_source, const ProgramCache* cache)
+{
+	// Skip compilation entirely if the cache has a binary for these sources
+	uint64_t cache_key = 0;
+	if (cache)
 	{
-		std::cout << "ERROR::SHADER::FILE_NOT_FOUND_SUCCESSFULLY_READ" << std::endl;
+		cache_key = ProgramCache::make_key(program_pieces(vertex_source, fragment_source));
+		id = cache->load(cache_key);
+		if (id != 0)
+		{
+			load_uniforms();
+			return;
+		}
 	}
-	const char* vertex_shader_code   = vertex_code.c_str();
-	const char* fragment_shader_code = fragment_code.c_str();
 
 
 	// 2. compile shaders
 	unsigned int vertex, fragment;
-	int success;
-	char info_log[512];
 
 	// vertex shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vertex_shader_code, nullptr);
-	glCompileShader(vertex);
-
-	// print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-	if (!success)
-	{
-		glGetShaderInfoLog(vertex, 512, nullptr, info_log);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << info_log << std::endl;
-	}
+	vertex = create_shader(GL_VERTEX_SHADER, vertex_source);
 
 	// fragment shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fragment_shader_code, nullptr);
-	glCompileShader(fragment);
+	fragment = create_shader(GL_FRAGMENT_SHADER, fragment_source);
 
 	// print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-	if (!success)
-	{
-		glGetShaderInfoLog(fragment, 512, nullptr, info_log);
-		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << info_log << std::endl;
-	}
+	check_compile(vertex, "VERTEX");
+	check_compile(fragment, "FRAGMENT");
 
 
 	// shader program
 	id = glCreateProgram();
 	glAttachShader(id, vertex);
 	glAttachShader(id, fragment);
+	if (cache)
+	{
+		glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(id);
 
 	// print linking errors if any
-	glGetProgramiv(id, GL_LINK_STATUS, &success);
-	if (!success)
+	if (check_link(id))
 	{
-		glGetProgramInfoLog(id, 512, nullptr, info_log);
-		std::cout << "ERROR:SHADER::PROGRAM::LINKING_FAILED\n" << info_log << std::endl;
+		load_uniforms();
+		if (cache)
+		{
+			cache->store(cache_key, id);
+		}
 	}
 
 	// delete shaders as they're linked in the program and no longer necessary
@@ -89,22 +116,217 @@ Shader::Shader(const char* vertex_path, const char* fragment_path)
 	glDeleteShader(fragment);
 }
 
+Shader::Shader(unsigned int program)
+	: id(program)
+{
+	load_uniforms();
+}
+
+unsigned int Shader::create_shader(GLenum type, const ShaderSource& source)
+{
+	// Hand the expanded pieces straight to the driver, lengths make null termination unnecessary
+	std::vector<const char*> pieces;
+	std::vector<GLint> lengths;
+	for (std::string_view piece : source.pieces())
+	{
+		pieces.push_back(piece.data());
+		lengths.push_back((GLint)piece.size());
+	}
+
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, (GLsizei)pieces.size(), pieces.data(), lengths.data());
+	glCompileShader(shader);
+	return shader;
+}
+
+unsigned int Shader::create_shader(GLenum type, const SpirvModule& module, const SpecializationConstants& constants)
+{
+	if (!spirv_supported())
+	{
+		return 0;
+	}
+	unsigned int shader = glCreateShader(type);
+	glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, module.data(), (GLsizei)module.size());
+#ifdef GL_ARB_gl_spirv
+	if (!GLAD_GL_VERSION_4_6)
+	{
+		glSpecializeShaderARB(shader, module.entry_point.c_str(), constants.count(),
+		                      constants.constant_ids(), constants.constant_values());
+		return shader;
+	}
+#endif
+	glSpecializeShader(shader, module.entry_point.c_str(), constants.count(),
+	                   constants.constant_ids(), constants.constant_values());
+	return shader;
+}
+
+bool Shader::spirv_supported()
+{
+	// The 4.5 fallback context (e.g. Mesa's llvmpipe) leaves glSpecializeShader unloaded.
+	// ARB_gl_spirv only counts if glad was generated with the extension.
+	bool supported = GLAD_GL_VERSION_4_6 != 0;
+#ifdef GL_ARB_gl_spirv
+	supported = supported || GLAD_GL_ARB_gl_spirv != 0;
+#endif
+	if (!supported)
+	{
+		std::cout << "ERROR::SHADER::SPIRV_NOT_SUPPORTED\nneeds GL 4.6 or ARB_gl_spirv" << std::endl;
+	}
+	return supported;
+}
+
+std::vector<std::string_view> Shader::program_pieces(const ShaderSource& vertex, const ShaderSource& fragment)
+{
+	std::vector<std::string_view> pieces = vertex.pieces();
+	pieces.insert(pieces.end(), fragment.pieces().begin(), fragment.pieces().end());
+	return pieces;
+}
+
+bool Shader::check_compile(unsigned int shader, const char* stage)
+{
+	int success;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		char info_log[512];
+		glGetShaderInfoLog(shader, 512, nullptr, info_log);
+		std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << info_log << std::endl;
+	}
+	return success;
+}
+
+bool Shader::check_link(unsigned int program)
+{
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char info_log[512];
+		glGetProgramInfoLog(program, 512, nullptr, info_log);
+		std::cout << "ERROR:SHADER::PROGRAM::LINKING_FAILED\n" << info_log << std::endl;
+	}
+	return success;
+}
+
+void Shader::swap_program(Shader& other)
+{
+	std::swap(id, other.id);
+	uniform_table.swap(other.uniform_table);
+}
+
 void Shader::use()
 {
-	glUseProgram(id);
+	GLState::get().use_program(id);
+}
+
+int Shader::location(const std::string& name) const
+{
+	auto it = std::lower_bound(uniform_table.begin(), uniform_table.end(), name,
+	                           [](const UniformEntry& entry, const std::string& key) { return entry.name < key; });
+	if (it == uniform_table.end() || it->name != name)
+	{
+		return -1;
+	}
+	return it->location;
+}
+
+void Shader::load_uniforms()
+{
+	uniform_table.clear();
+
+	int count = 0;
+	int max_length = 0;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	std::vector<char> name_buffer(max_length > 0 ? max_length : 1);
+
+	for (int i = 0; i < count; i++)
+	{
+		int length = 0;
+		int size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(id, (GLuint)i, (GLsizei)name_buffer.size(), &length, &size, &type, name_buffer.data());
+		std::string name(name_buffer.data(), length);
+
+		// Uniforms inside blocks have no location, they are set through buffers
+		int location = glGetUniformLocation(id, name.c_str());
+		if (location < 0)
+		{
+			continue;
+		}
+		uniform_table.push_back({ name, location });
+
+		// Arrays are reported as "name[0]", also allow looking them up by "name"
+		const std::string array_suffix = "[0]";
+		if (name.size() > array_suffix.size() &&
+			name.compare(name.size() - array_suffix.size(), array_suffix.size(), array_suffix) == 0)
+		{
+			uniform_table.push_back({ name.substr(0, name.size() - array_suffix.size()), location });
+		}
+	}
+
+	std::sort(uniform_table.begin(), uniform_table.end(),
+	          [](const UniformEntry& a, const UniformEntry& b) { return a.name < b.name; });
 }
 
 void Shader::set(const std::string& name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value);
+	glProgramUniform1i(id, location(name), (int)value);
 }
 
 void Shader::set(const std::string& name, int value) const
 {
-	glUniform1i(glGetUniformLocation(id, name.c_str()), value);
+	glProgramUniform1i(id, location(name), value);
 }
 
 void Shader::set(const std::string& name, float value) const
 {
-	glUniform1f(glGetUniformLocation(id, name.c_str()), value);
+	glProgramUniform1f(id, location(name), value);
+}
+
+void Shader::set(const std::string& name, const glm::vec3& value) const
+{
+	glProgramUniform3f(id, location(name), value.x, value.y, value.z);
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+	glProgramUniform1i(id, uniform.location, (int)value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const
+{
+	glProgramUniform1i(id, uniform.location, value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const
+{
+	glProgramUniform1f(id, uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+	glProgramUniform3f(id, uniform.location, value.x, value.y, value.z);
+}
+
+bool Shader::bind_uniform_block(const std::string& name, unsigned int binding) const
+{
+	const GLuint index = glGetUniformBlockIndex(id, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		return false;
+	}
+	glUniformBlockBinding(id, index, binding);
+	return true;
+}
+
+bool Shader::bind_storage_block(const std::string& name, unsigned int binding) const
+{
+	const GLuint index = glGetProgramResourceIndex(id, GL_SHADER_STORAGE_BLOCK, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		return false;
+	}
+	glShaderStorageBlockBinding(id, index, binding);
+	return true;
 }
@@ -1,12 +1,28 @@
 #pragma once
 
 #include <glad/glad.h> // Get OpenGL headers
+#include <glm/glm.hpp>
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 
+#include "GLState.h"
+#include "ProgramCache.h"
+#include "ShaderSource.h"
+#include "SpirvModule.h"
+
+
+// Typed handle to a uniform location resolved once at link time.
+// Writes through a handle skip the name lookup entirely.
+template <typename T>
+struct Uniform
+{
+	int location = -1; // -1 if the uniform is not active in the program
+
+	bool valid() const { return location >= 0; }
+};
 
 class Shader
 {
@@ -15,13 +31,92 @@ public:
 	unsigned int id; // ID Reference to shader program containing defined vertex and fragment shaders
 
 	// Constructor (reads and builds shader)
-	Shader(const char* vertex_path, const char* fragment_path);
+	// If a cache is given, a matching program binary is loaded instead of compiling.
+	// Defines are injected into both stages after #version.
+	Shader(const char* vertex_path, const char* fragment_path, const ProgramCache* cache = nullptr,
+	       const ShaderDefines& defines = {});
+
+	// Build from sources compiled into the executable (see embed_shaders.py)
+	Shader(const ShaderLibrary& library, const char* vertex_name, const char* fragment_name,
+	       const ProgramCache* cache = nullptr, const ShaderDefines& defines = {});
 
-	// Activate the shader (use)
+	// Build from offline compiled SPIR-V, variants are selected through specialization constants.
+	// Each stage is specialized with the constants of the set it declares. id is 0 without
+	// SPIR-V support in the context.
+	Shader(const SpirvModule& vertex_module, const SpirvModule& fragment_module,
+	       const SpecializationConstants& constants = {});
+
+	// Adopt an already linked program (see ShaderBuilder)
+	explicit Shader(unsigned int program);
+
+	// Exchange programs (and their uniform tables) with another shader, used for hot reload
+	void swap_program(Shader& other);
+
+	// Activate the shader (use), skipped if it is already current
 	void use();
 
+	// Location of an active uniform from the link time table (-1 if not found)
+	int location(const std::string& name) const;
+
+	// Resolve a typed uniform handle, do this once outside the render loop
+	template <typename T>
+	Uniform<T> uniform(const std::string& name) const
+	{
+		return Uniform<T>{ location(name) };
+	}
+
 	// Utility uniform functions
 	void set(const std::string& name, bool value) const;
 	void set(const std::string& name, int value) const;
 	void set(const std::string& name, float value) const;
+	void set(const std::string& name, const glm::vec3& value) const;
+
+	// Hot path uniform functions (no string work, program does not need to be bound)
+	void set(Uniform<bool> uniform, bool value) const;
+	void set(Uniform<int> uniform, int value) const;
+	void set(Uniform<float> uniform, float value) const;
+	void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+
+	// Point a uniform/storage block at a binding point (see BlockBuffer in UniformBlock.h).
+	// Only needed for blocks without `layout(binding = N)`, returns false if the block isn't active.
+	bool bind_uniform_block(const std::string& name, unsigned int binding) const;
+	bool bind_storage_block(const std::string& name, unsigned int binding) const;
+
+	// Create a shader object from preprocessed source and start compiling it
+	static unsigned int create_shader(GLenum type, const ShaderSource& source);
+
+	// Create a shader object from a SPIR-V module and specialize it (blocks like compiling).
+	// Returns 0 if the context can't load SPIR-V, see spirv_supported().
+	static unsigned int create_shader(GLenum type, const SpirvModule& module, const SpecializationConstants& constants);
+
+	// GL 4.6 or ARB_gl_spirv, prints an error if neither is there
+	static bool spirv_supported();
+
+	// All source pieces of a program, in the order used for its ProgramCache key
+	static std::vector<std::string_view> program_pieces(const ShaderSource& vertex, const ShaderSource& fragment);
+
+	// Print the info log and return false if compiling/linking failed.
+	// Both block until the driver has finished the shader/program.
+	static bool check_compile(unsigned int shader, const char* stage);
+	static bool check_link(unsigned int program);
+
+protected:
+	// No program yet, for derived shaders that link other stages (see ComputeShader)
+	Shader() : id(0) {}
+
+	// Enumerate GL_ACTIVE_UNIFORMS of the linked program into uniform_table
+	void load_uniforms();
+
+private:
+	struct UniformEntry
+	{
+		std::string name;
+		int location;
+	};
+
+	// Active uniforms sorted by name, rebuilt after every successful link
+	std::vector<UniformEntry> uniform_table;
+
+	// Compile and link preprocessed sources into id
+	void build(const ShaderSource& vertex_source, const ShaderSource& fragment_source, const ProgramCache* cache);
 };
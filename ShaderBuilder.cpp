@@ -0,0 +1,326 @@
+#include "ShaderBuilder.h"
+
+namespace
+{
+	typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+	bool extension_supported(const char* name)
+	{
+		int count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (int i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension && strcmp(extension, name) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool PendingShader::ready() const
+{
+	return job && (job->state == State::Done || job->state == State::Failed);
+}
+
+bool PendingShader::failed() const
+{
+	return job && job->state == State::Failed;
+}
+
+Shader* PendingShader::get() const
+{
+	return job && job->state == State::Done ? job->shader.get() : nullptr;
+}
+
+const std::vector<std::string>& PendingShader::dependencies() const
+{
+	static const std::vector<std::string> none;
+	return job ? job->dependencies : none;
+}
+
+ShaderBuilder::ShaderBuilder(GLADloadproc loader, const ProgramCache* cache)
+	: cache(cache)
+{
+	if (cache)
+	{
+		driver = ProgramCache::driver_hash();
+	}
+
+	const char* extension = nullptr;
+	if (extension_supported("GL_KHR_parallel_shader_compile"))
+	{
+		extension = "glMaxShaderCompilerThreadsKHR";
+	}
+	else if (extension_supported("GL_ARB_parallel_shader_compile"))
+	{
+		extension = "glMaxShaderCompilerThreadsARB";
+	}
+	if (!extension)
+	{
+		return;
+	}
+
+	parallel_compile = true;
+
+	// Let the driver pick how many compiler threads to use
+	auto max_threads = (MaxShaderCompilerThreadsProc)loader(extension);
+	if (max_threads)
+	{
+		max_threads(0xFFFFFFFF);
+	}
+}
+
+PendingShader ShaderBuilder::request(const char* vertex_path, const char* fragment_path,
+                                     const ShaderDefines& defines, bool share)
+{
+	auto job = std::make_shared<PendingShader::Job>();
+	job->vertex_path   = vertex_path;
+	job->fragment_path = fragment_path;
+	job->defines       = defines;
+	job->share         = share;
+	return start(job);
+}
+
+PendingShader ShaderBuilder::request(const ShaderLibrary& library, const char* vertex_name, const char* fragment_name,
+                                     const ShaderDefines& defines)
+{
+	auto job = std::make_shared<PendingShader::Job>();
+	job->vertex_path   = vertex_name;
+	job->fragment_path = fragment_name;
+	job->defines       = defines;
+	job->library       = &library;
+	return start(job);
+}
+
+PendingShader ShaderBuilder::start(const std::shared_ptr<PendingShader::Job>& job)
+{
+	PendingShader::Job* target = job.get();
+	const ProgramCache* program_cache = cache;
+	const uint64_t driver_key = driver;
+	job->sources = std::async(std::launch::async, [target, program_cache, driver_key]()
+	{
+		if (target->library)
+		{
+			if (!target->vertex_source.load(*target->library, target->vertex_path.c_str(), target->defines) ||
+				!target->fragment_source.load(*target->library, target->fragment_path.c_str(), target->defines))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			if (!target->vertex_source.load(target->vertex_path.c_str(), target->defines) ||
+				!target->fragment_source.load(target->fragment_path.c_str(), target->defines))
+			{
+				return false;
+			}
+			// Fault the pages in here so the GL thread never waits on the disk
+			target->vertex_source.prefetch();
+			target->fragment_source.prefetch();
+		}
+
+		// The cached binary is read here for the same reason
+		if (program_cache)
+		{
+			target->cache_key = ProgramCache::make_key(driver_key,
+				Shader::program_pieces(target->vertex_source, target->fragment_source));
+			program_cache->read(target->cache_key, target->cached);
+		}
+		return true;
+	});
+	jobs.push_back(job);
+
+	PendingShader pending;
+	pending.job = job;
+	return pending;
+}
+
+void ShaderBuilder::update()
+{
+	using State = PendingShader::State;
+
+	// Issue every compile whose sources are in before polling anything,
+	// so the driver's compiler threads get as much work as possible
+	for (auto& job : jobs)
+	{
+		if (job->state == State::Reading &&
+			job->sources.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			issue(job);
+		}
+	}
+
+	for (auto& job : jobs)
+	{
+		if (job->state == State::Compiling && completed(*job))
+		{
+			complete(*job);
+		}
+	}
+
+	// Variants that matched an earlier build take its result once it's done
+	for (auto& job : jobs)
+	{
+		const auto& original = job->original;
+		if (job->state == State::Sharing && (original->state == State::Done || original->state == State::Failed))
+		{
+			job->shader = original->shader;
+			job->state  = original->state;
+			job->original.reset();
+		}
+	}
+
+	// Forget cache writes that are done, a ready future doesn't block when destroyed
+	writes.erase(std::remove_if(writes.begin(), writes.end(), [](const std::future<void>& write)
+	{
+		return write.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), writes.end());
+
+	const size_t count = jobs.size();
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const auto& job)
+	{
+		return job->state == State::Done || job->state == State::Failed;
+	}), jobs.end());
+
+	// Forget variants nobody holds on to anymore
+	if (jobs.size() != count)
+	{
+		for (auto it = variants.begin(); it != variants.end();)
+		{
+			it = it->second.expired() ? variants.erase(it) : std::next(it);
+		}
+	}
+}
+
+void ShaderBuilder::finish()
+{
+	while (!jobs.empty())
+	{
+		update();
+		if (!jobs.empty())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ShaderBuilder::issue(const std::shared_ptr<PendingShader::Job>& pending)
+{
+	using State = PendingShader::State;
+	PendingShader::Job& job = *pending;
+
+	if (!job.sources.get())
+	{
+		job.state = State::Failed;
+		return;
+	}
+
+	job.dependencies = job.vertex_source.files();
+	job.dependencies.insert(job.dependencies.end(),
+	                        job.fragment_source.files().begin(), job.fragment_source.files().end());
+
+	// Identical expanded sources are compiled once and shared
+	if (job.share)
+	{
+		uint64_t vertex_hash = fnv1a((uint64_t)job.vertex_source.size(), job.vertex_source.hash());
+		job.content_hash = job.fragment_source.hash(vertex_hash);
+		auto variant = variants.find(job.content_hash);
+		if (variant != variants.end())
+		{
+			if (auto original = variant->second.lock())
+			{
+				job.vertex_source.clear();
+				job.fragment_source.clear();
+				job.cached   = ProgramCache::Binary();
+				job.original = original;
+				job.state    = State::Sharing;
+				return;
+			}
+		}
+		variants[job.content_hash] = pending;
+	}
+
+	// A rejected binary is simply rebuilt from source, the new one replaces the entry
+	if (!job.cached.data.empty())
+	{
+		unsigned int program = ProgramCache::create(job.cached);
+		job.cached = ProgramCache::Binary();
+		if (program != 0)
+		{
+			job.vertex_source.clear();
+			job.fragment_source.clear();
+			job.shader = std::make_shared<Shader>(program);
+			job.state  = State::Done;
+			return;
+		}
+	}
+
+	job.vertex   = Shader::create_shader(GL_VERTEX_SHADER, job.vertex_source);
+	job.fragment = Shader::create_shader(GL_FRAGMENT_SHADER, job.fragment_source);
+
+	// Link straight away, with parallel compile this doesn't wait for the compiles
+	job.program = glCreateProgram();
+	glAttachShader(job.program, job.vertex);
+	glAttachShader(job.program, job.fragment);
+	if (cache)
+	{
+		glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(job.program);
+
+	// Sources are in the driver now
+	job.vertex_source.clear();
+	job.fragment_source.clear();
+
+	job.state = State::Compiling;
+}
+
+bool ShaderBuilder::completed(const PendingShader::Job& job) const
+{
+	if (!parallel_compile)
+	{
+		return true; // Status queries will block, nothing to poll
+	}
+	int done = GL_FALSE;
+	glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+void ShaderBuilder::complete(PendingShader::Job& job)
+{
+	using State = PendingShader::State;
+
+	bool success = Shader::check_compile(job.vertex, "VERTEX");
+	success = Shader::check_compile(job.fragment, "FRAGMENT") && success;
+	success = Shader::check_link(job.program) && success;
+
+	glDeleteShader(job.vertex);
+	glDeleteShader(job.fragment);
+	job.vertex   = 0;
+	job.fragment = 0;
+
+	if (!success)
+	{
+		glDeleteProgram(job.program);
+		job.program = 0;
+		job.state   = State::Failed;
+		return;
+	}
+
+	// Only fetching the binary needs the context, the file is written in the background
+	ProgramCache::Binary binary;
+	if (cache && ProgramCache::retrieve(job.program, binary))
+	{
+		const ProgramCache* program_cache = cache;
+		const uint64_t key = job.cache_key;
+		writes.push_back(std::async(std::launch::async, [program_cache, key, binary = std::move(binary)]()
+		{
+			program_cache->write(key, binary);
+		}));
+	}
+	job.shader = std::make_shared<Shader>(job.program);
+	job.state  = State::Done;
+}
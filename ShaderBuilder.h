@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <future>
+#include <thread>
+#include <cstring>
+#include <iostream>
+
+#include "Shader.h"
+#include "ProgramCache.h"
+
+
+// GL_KHR_parallel_shader_compile isn't part of the generated glad core loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+
+
+// Handle to a shader program that is being built by a ShaderBuilder.
+// Cheap to copy, all copies refer to the same build.
+class PendingShader
+{
+public:
+	PendingShader() = default;
+
+	// True if this refers to a build
+	bool valid() const { return job != nullptr; }
+
+	// True once the build finished, successfully or not
+	bool ready() const;
+	// True if reading, compiling or linking failed
+	bool failed() const;
+	// The built shader, nullptr until ready() and not failed()
+	Shader* get() const;
+
+	// Files the shader was built from, including #includes (empty until ready())
+	const std::vector<std::string>& dependencies() const;
+
+private:
+	friend class ShaderBuilder;
+
+	// Sharing: waiting for an identical variant that is already being built
+	enum class State { Reading, Compiling, Sharing, Done, Failed };
+
+	struct Job
+	{
+		std::string vertex_path;
+		std::string fragment_path;
+		ShaderDefines defines;
+		const ShaderLibrary* library = nullptr; // paths are embedded shader names if set
+		bool share = true;
+
+		// Filled by a worker thread, only touched here once the future is ready
+		std::future<bool> sources;
+		ShaderSource vertex_source;
+		ShaderSource fragment_source;
+		std::vector<std::string> dependencies;
+
+		unsigned int vertex   = 0;
+		unsigned int fragment = 0;
+		unsigned int program  = 0;
+		uint64_t content_hash = 0;
+		uint64_t cache_key    = 0; // made by the worker thread with the sources
+		ProgramCache::Binary cached; // read by the worker thread, empty on a miss
+
+		State state = State::Reading;
+		std::shared_ptr<Shader> shader;
+		std::shared_ptr<Job> original; // build this one shares its program with
+	};
+
+	std::shared_ptr<Job> job;
+};
+
+// Builds shader programs without blocking the render loop.
+// Sources are read on worker threads, compiles and links are issued as soon as
+// sources arrive and completion is polled with GL_COMPLETION_STATUS_KHR when the
+// driver supports GL_KHR_parallel_shader_compile. All GL calls happen in update()
+// which must be called on the thread that owns the context.
+// With a ProgramCache, entries are read by the worker that reads the sources and new
+// binaries are written on a background thread, update() never waits on the disk.
+// Destroying the builder waits for outstanding cache writes.
+class ShaderBuilder
+{
+public:
+	// loader is used to fetch the extension entry point (e.g. glfwGetProcAddress)
+	explicit ShaderBuilder(GLADloadproc loader, const ProgramCache* cache = nullptr);
+
+	// Queue a build, reading and preprocessing start immediately on a worker thread.
+	// Builds whose expanded sources are identical share one program. Hot reload passes
+	// share = false so a rebuilt program never replaces one that other variants use.
+	PendingShader request(const char* vertex_path, const char* fragment_path,
+	                      const ShaderDefines& defines = {}, bool share = true);
+
+	// Queue a build of shaders embedded in the executable
+	PendingShader request(const ShaderLibrary& library, const char* vertex_name, const char* fragment_name,
+	                      const ShaderDefines& defines = {});
+
+	// Issue compiles for newly read sources and finish completed programs (call once per frame)
+	void update();
+
+	// Block until every queued build has finished
+	void finish();
+
+	// Number of builds that have not finished yet
+	size_t pending() const { return jobs.size(); }
+
+	// True if the driver compiles in the background
+	bool parallel() const { return parallel_compile; }
+
+private:
+	const ProgramCache* cache;
+	uint64_t driver = 0; // ProgramCache::driver_hash() of the context
+	bool parallel_compile = false;
+	std::vector<std::future<void>> writes; // cache entries being written
+	std::vector<std::shared_ptr<PendingShader::Job>> jobs;
+
+	// Expanded source hash -> first build of that variant, while anyone still holds it
+	std::unordered_map<uint64_t, std::weak_ptr<PendingShader::Job>> variants;
+
+	PendingShader start(const std::shared_ptr<PendingShader::Job>& job);
+	void issue(const std::shared_ptr<PendingShader::Job>& job);
+	bool completed(const PendingShader::Job& job) const;
+	void complete(PendingShader::Job& job);
+};
@@ -0,0 +1,208 @@
+#include "ShaderSource.h"
+
+namespace
+{
+	constexpr int max_include_depth = 32;
+
+	std::string_view trim_front(std::string_view text)
+	{
+		size_t start = text.find_first_not_of(" \t");
+		return start == std::string_view::npos ? std::string_view() : text.substr(start);
+	}
+
+	bool starts_with(std::string_view text, std::string_view prefix)
+	{
+		return text.substr(0, prefix.size()) == prefix;
+	}
+}
+
+bool ShaderSource::load(const char* path, const ShaderDefines& defines)
+{
+	clear();
+	library = nullptr;
+	return expand(path, prelude_for(defines), 0);
+}
+
+bool ShaderSource::load(const ShaderLibrary& shaders, const char* name, const ShaderDefines& defines)
+{
+	clear();
+	library = &shaders;
+	return expand(name, prelude_for(defines), 0);
+}
+
+std::string ShaderSource::prelude_for(const ShaderDefines& defines)
+{
+	std::string prelude;
+	for (const std::string& define : defines)
+	{
+		prelude += "#define " + define + "\n";
+	}
+	return prelude;
+}
+
+void ShaderSource::clear()
+{
+	segments.clear();
+	generated.clear();
+	mapped.clear();
+	file_paths.clear();
+}
+
+void ShaderSource::prefetch() const
+{
+	for (const auto& file : mapped)
+	{
+		file->prefetch();
+	}
+}
+
+size_t ShaderSource::size() const
+{
+	size_t length = 0;
+	for (std::string_view piece : segments)
+	{
+		length += piece.size();
+	}
+	return length;
+}
+
+uint64_t ShaderSource::hash(uint64_t seed) const
+{
+	for (std::string_view piece : segments)
+	{
+		seed = fnv1a(piece, seed);
+	}
+	return seed;
+}
+
+void ShaderSource::append(std::string_view piece)
+{
+	if (!piece.empty())
+	{
+		segments.push_back(piece);
+	}
+}
+
+void ShaderSource::append(std::string text)
+{
+	generated.push_back(std::move(text));
+	segments.push_back(generated.back());
+}
+
+bool ShaderSource::expand(const std::filesystem::path& path, const std::string& prelude, int depth)
+{
+	std::string key;
+	if (library)
+	{
+		key = path.lexically_normal().generic_string();
+	}
+	else
+	{
+		std::error_code ec;
+		std::filesystem::path normalized = std::filesystem::weakly_canonical(path, ec);
+		key = ec ? path.string() : normalized.string();
+	}
+
+	// Include once, a file that's already been pasted in is skipped
+	for (const std::string& included : file_paths)
+	{
+		if (included == key)
+		{
+			return true;
+		}
+	}
+
+	std::string_view text;
+	if (library)
+	{
+		const EmbeddedShader* shader = library->find(key);
+		if (!shader)
+		{
+			std::cout << "ERROR::SHADER::EMBEDDED_SHADER_NOT_FOUND\n" << key << std::endl;
+			return false;
+		}
+		text = shader->code;
+	}
+	else
+	{
+		auto file = std::make_unique<MappedFile>();
+		if (!file->open(key.c_str()))
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n" << key << ": " << file->error() << std::endl;
+			return false;
+		}
+		text = file->view();
+		mapped.push_back(std::move(file));
+	}
+
+	const int file_index = (int)file_paths.size();
+	file_paths.push_back(key);
+	if (depth > 0)
+	{
+		append("#line 1 " + std::to_string(file_index) + "\n");
+	}
+
+	bool prelude_added = prelude.empty();
+	size_t piece_start = 0;
+	size_t line_start  = 0;
+	int line_number    = 1;
+	while (line_start < text.size())
+	{
+		size_t line_end = text.find('\n', line_start);
+		line_end = line_end == std::string_view::npos ? text.size() : line_end + 1;
+		const std::string_view line = trim_front(text.substr(line_start, line_end - line_start));
+
+		if (!prelude_added && starts_with(line, "#version"))
+		{
+			// Defines have to follow #version, then restore the line numbering
+			append(text.substr(piece_start, line_end - piece_start));
+			if (line_end == text.size() && text.back() != '\n')
+			{
+				append(std::string("\n"));
+			}
+			append(prelude + "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n");
+			piece_start   = line_end;
+			prelude_added = true;
+		}
+		else if (starts_with(line, "#include"))
+		{
+			const size_t open_quote  = line.find('"');
+			const size_t close_quote = open_quote == std::string_view::npos ? open_quote : line.find('"', open_quote + 1);
+			if (close_quote == std::string_view::npos)
+			{
+				std::cout << "ERROR::SHADER::MALFORMED_INCLUDE\n" << key << ":" << line_number << std::endl;
+				return false;
+			}
+			if (depth + 1 >= max_include_depth)
+			{
+				std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP\n" << key << ":" << line_number << std::endl;
+				return false;
+			}
+
+			append(text.substr(piece_start, line_start - piece_start));
+
+			const std::string name(line.substr(open_quote + 1, close_quote - open_quote - 1));
+			const std::filesystem::path include_path = std::filesystem::path(key).parent_path() / name;
+			if (!expand(include_path, std::string(), depth + 1))
+			{
+				std::cout << "  included from " << key << ":" << line_number << std::endl;
+				return false;
+			}
+			// Leading newline in case the included file didn't end with one
+			append("\n#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n");
+			piece_start = line_end;
+		}
+
+		line_start = line_end;
+		line_number++;
+	}
+	append(text.substr(piece_start));
+
+	// No #version line, defines go first
+	if (!prelude_added)
+	{
+		generated.push_back(prelude + "#line 1 " + std::to_string(file_index) + "\n");
+		segments.insert(segments.begin(), generated.back());
+	}
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <filesystem>
+#include <iostream>
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+
+// Defines injected after #version, e.g. { "SKINNED", "MAX_LIGHTS 4" }
+using ShaderDefines = std::vector<std::string>;
+
+// Shader source compiled into the executable (see embed_shaders.py)
+struct EmbeddedShader
+{
+	std::string_view name;
+	std::string_view code;
+};
+
+// Table of embedded shaders, looked up by file name
+struct ShaderLibrary
+{
+	const EmbeddedShader* shaders;
+	size_t count;
+
+	const EmbeddedShader* find(std::string_view name) const
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (shaders[i].name == name)
+			{
+				return &shaders[i];
+			}
+		}
+		return nullptr;
+	}
+};
+
+// Preprocessed GLSL source for one shader stage.
+// #include "file" is resolved relative to the including file (each file is included
+// at most once) and defines are injected after the #version line. The expanded text
+// is kept as a list of pieces pointing into the mapped files, so it can be handed to
+// glShaderSource as several strings without being copied together.
+class ShaderSource
+{
+public:
+	// Expand the file at path, prints the reason and returns false on failure
+	bool load(const char* path, const ShaderDefines& defines = {});
+
+	// Expand an embedded shader, #includes are looked up in the same library
+	bool load(const ShaderLibrary& library, const char* name, const ShaderDefines& defines = {});
+	void clear();
+
+	// Touch the mapped pages so compiling never waits on the disk
+	void prefetch() const;
+
+	// Pieces of the expanded source, in order
+	const std::vector<std::string_view>& pieces() const { return segments; }
+
+	// Length of the expanded text
+	size_t size() const;
+
+	// Hash of the expanded text, identical variants hash the same however they were built
+	uint64_t hash(uint64_t seed = fnv1a_offset) const;
+
+	// Every file that contributed to the source, the first one is the file passed to load().
+	// #line directives refer to files by their index in this list.
+	const std::vector<std::string>& files() const { return file_paths; }
+
+private:
+	std::vector<std::unique_ptr<MappedFile>> mapped;
+	std::deque<std::string> generated; // #define and #line text, a deque keeps the pieces stable
+	std::vector<std::string_view> segments;
+	std::vector<std::string> file_paths;
+	const ShaderLibrary* library = nullptr; // set while expanding embedded sources
+
+	bool expand(const std::filesystem::path& path, const std::string& prelude, int depth);
+	static std::string prelude_for(const ShaderDefines& defines);
+	void append(std::string_view piece);
+	void append(std::string text);
+};
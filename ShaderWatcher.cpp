@@ -0,0 +1,220 @@
+#include "ShaderWatcher.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+ShaderWatcher::ShaderWatcher(ShaderBuilder& builder)
+	: builder(builder)
+{
+#ifdef __linux__
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+	{
+		std::cout << "WARNING::SHADER_WATCHER::INOTIFY_UNAVAILABLE" << std::endl;
+		return;
+	}
+#endif
+	thread = std::thread(&ShaderWatcher::run, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	running = false;
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+#ifdef __linux__
+	if (inotify_fd >= 0)
+	{
+		close(inotify_fd);
+	}
+#endif
+}
+
+std::string ShaderWatcher::normalize(const std::string& path)
+{
+	std::error_code ec;
+	std::filesystem::path normalized = std::filesystem::weakly_canonical(path, ec);
+	return ec ? path : normalized.string();
+}
+
+void ShaderWatcher::watch(const PendingShader& shader, const char* vertex_path, const char* fragment_path,
+                          const ShaderDefines& defines)
+{
+	Entry entry;
+	entry.target        = shader;
+	entry.vertex_path   = vertex_path;
+	entry.fragment_path = fragment_path;
+	entry.defines       = defines;
+	track(entry, { normalize(vertex_path), normalize(fragment_path) });
+	entries.push_back(std::move(entry));
+}
+
+void ShaderWatcher::track(Entry& entry, const std::vector<std::string>& dependencies)
+{
+	for (const std::string& path : dependencies)
+	{
+		if (std::find(entry.keys.begin(), entry.keys.end(), path) == entry.keys.end())
+		{
+			entry.keys.push_back(path);
+			add_file(path);
+		}
+	}
+}
+
+void ShaderWatcher::add_file(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!files.insert(path).second)
+	{
+		return;
+	}
+
+#ifdef __linux__
+	// Watch the directory, editors often save by writing a new file and renaming it over the old one
+	const std::string directory = std::filesystem::path(path).parent_path().string();
+	for (const auto& watched : watch_directories)
+	{
+		if (watched.second == directory)
+		{
+			return;
+		}
+	}
+	if (inotify_fd >= 0)
+	{
+		int wd = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd < 0)
+		{
+			std::cout << "WARNING::SHADER_WATCHER::CANNOT_WATCH " << directory << std::endl;
+			return;
+		}
+		watch_directories[wd] = directory;
+	}
+#else
+	std::error_code ec;
+	write_times[path] = std::filesystem::last_write_time(path, ec);
+#endif
+}
+
+void ShaderWatcher::update()
+{
+	// Never wait on the watcher thread, pick the changes up next frame instead
+	std::unordered_set<std::string> frame_changes;
+	{
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (lock.owns_lock())
+		{
+			frame_changes.swap(changed);
+		}
+	}
+
+	for (Entry& entry : entries)
+	{
+		// Includes are only known once the first build has preprocessed the sources
+		if (!entry.dependencies_known && entry.target.ready())
+		{
+			track(entry, entry.target.dependencies());
+			entry.dependencies_known = true;
+		}
+
+		for (const std::string& key : entry.keys)
+		{
+			if (frame_changes.count(key))
+			{
+				entry.dirty = true;
+			}
+		}
+
+		// Swap at the frame boundary, the old program stays in use if the new one failed
+		if (entry.rebuild.ready())
+		{
+			Shader* built  = entry.rebuild.get();
+			Shader* target = entry.target.get();
+			if (built && target)
+			{
+				// An edit may have added includes
+				track(entry, entry.rebuild.dependencies());
+
+				target->swap_program(*built);
+				glDeleteProgram(built->id);
+				GLState::get().deleted_program(built->id);
+				built->id = 0;
+				reload_count++;
+				std::cout << "Info: Reloaded " << entry.vertex_path << ", " << entry.fragment_path << std::endl;
+			}
+			entry.rebuild = PendingShader();
+		}
+
+		// One rebuild in flight per shader, later changes queue another once it finishes
+		if (entry.dirty && !entry.rebuild.valid() && entry.target.ready())
+		{
+			entry.rebuild = builder.request(entry.vertex_path.c_str(), entry.fragment_path.c_str(), entry.defines, false);
+			entry.dirty   = false;
+		}
+	}
+}
+
+#ifdef __linux__
+
+void ShaderWatcher::run()
+{
+	alignas(inotify_event) char buffer[4096];
+	while (running)
+	{
+		pollfd descriptor{ inotify_fd, POLLIN, 0 };
+		if (poll(&descriptor, 1, 100) <= 0)
+		{
+			continue;
+		}
+
+		ssize_t length;
+		while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (char* cursor = buffer; cursor < buffer + length;)
+			{
+				const inotify_event* event = (const inotify_event*)cursor;
+				cursor += sizeof(inotify_event) + event->len;
+
+				auto directory = watch_directories.find(event->wd);
+				if (event->len == 0 || directory == watch_directories.end())
+				{
+					continue;
+				}
+				std::string path = (std::filesystem::path(directory->second) / event->name).string();
+				if (files.count(path))
+				{
+					changed.insert(path);
+				}
+			}
+		}
+	}
+}
+
+#else
+
+void ShaderWatcher::run()
+{
+	while (running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& file : write_times)
+		{
+			std::error_code ec;
+			auto time = std::filesystem::last_write_time(file.first, ec);
+			if (!ec && time != file.second)
+			{
+				file.second = time;
+				changed.insert(file.first);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "Shader.h"
+#include "ShaderBuilder.h"
+
+
+// Hot reloads shaders when their source files change on disk.
+// A watcher thread (inotify on Linux, timestamp polling elsewhere) records changed
+// files. update() runs at a frame boundary: it queues rebuilds on the ShaderBuilder
+// and swaps a rebuilt program into its Shader only if it linked successfully, so the
+// render loop never waits on the disk or the compiler.
+class ShaderWatcher
+{
+public:
+	explicit ShaderWatcher(ShaderBuilder& builder);
+	~ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	// Rebuild shader whenever one of its sources or their #includes change.
+	// Pass the same paths and defines it was requested with.
+	// Uniform handles taken from it must be re-resolved after a reload.
+	void watch(const PendingShader& shader, const char* vertex_path, const char* fragment_path,
+	           const ShaderDefines& defines = {});
+
+	// Queue rebuilds for changed sources and swap in finished ones (call once per frame)
+	void update();
+
+	// Number of programs swapped in so far
+	size_t reloads() const { return reload_count; }
+
+private:
+	struct Entry
+	{
+		PendingShader target;
+		std::string vertex_path;
+		std::string fragment_path;
+		ShaderDefines defines;
+		std::vector<std::string> keys;     // normalized paths of every source file, matched against change events
+		bool dependencies_known = false;   // keys include the #includes found by the first build
+		bool dirty = false;                // sources changed since the last rebuild was queued
+		PendingShader rebuild;
+	};
+
+	ShaderBuilder& builder;
+	std::vector<Entry> entries;
+	size_t reload_count = 0;
+
+	// Shared with the watcher thread
+	std::mutex mutex;
+	std::unordered_set<std::string> changed;   // normalized paths reported since the last update()
+	std::unordered_set<std::string> files;     // normalized paths being watched
+	std::atomic<bool> running{ true };
+	std::thread thread;
+
+#ifdef __linux__
+	int inotify_fd = -1;
+	std::unordered_map<int, std::string> watch_directories; // inotify watch descriptor -> directory
+#else
+	std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
+#endif
+
+	static std::string normalize(const std::string& path);
+	void add_file(const std::string& path);
+	void track(Entry& entry, const std::vector<std::string>& dependencies);
+	void run();
+};
@@ -0,0 +1,133 @@
+#include "SpirvModule.h"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr uint32_t spirv_magic = 0x07230203;
+	constexpr size_t header_words = 5;
+	constexpr uint32_t op_decorate = 71;
+	constexpr uint32_t decoration_spec_id = 1;
+}
+
+bool SpirvModule::open(const char* path)
+{
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n" << path << ": " << file.error() << std::endl;
+		return false;
+	}
+	code = file.view();
+	return validate(path);
+}
+
+bool SpirvModule::load(const ShaderLibrary& library, const char* name)
+{
+	const EmbeddedShader* shader = library.find(name);
+	if (!shader)
+	{
+		std::cout << "ERROR::SHADER::EMBEDDED_SHADER_NOT_FOUND\n" << name << std::endl;
+		return false;
+	}
+	file.close();
+	code = shader->code;
+	return validate(name);
+}
+
+bool SpirvModule::validate(const std::string& name)
+{
+	uint32_t magic = 0;
+	if (code.size() >= sizeof(magic))
+	{
+		memcpy(&magic, code.data(), sizeof(magic));
+	}
+	if (magic != spirv_magic || code.size() % 4 != 0)
+	{
+		std::cout << "ERROR::SHADER::NOT_A_SPIRV_MODULE\n" << name << std::endl;
+		code = std::string_view();
+		return false;
+	}
+	find_spec_ids();
+	return true;
+}
+
+void SpirvModule::find_spec_ids()
+{
+	// Walk the instruction stream for OpDecorate <id> SpecId <constant_id>, words are
+	// copied out because embedded modules needn't be 4 byte aligned
+	spec_ids.clear();
+	const size_t word_count = code.size() / 4;
+	auto word = [&](size_t index)
+	{
+		uint32_t value;
+		memcpy(&value, code.data() + index * 4, sizeof(value));
+		return value;
+	};
+	size_t index = header_words;
+	while (index < word_count)
+	{
+		const uint32_t instruction = word(index);
+		const uint32_t length = instruction >> 16;
+		if (length == 0 || index + length > word_count)
+		{
+			break;
+		}
+		if ((instruction & 0xFFFF) == op_decorate && length >= 4 && word(index + 2) == decoration_spec_id)
+		{
+			spec_ids.push_back(word(index + 3));
+		}
+		index += length;
+	}
+}
+
+bool SpirvModule::declares_constant(uint32_t constant_id) const
+{
+	return std::find(spec_ids.begin(), spec_ids.end(), constant_id) != spec_ids.end();
+}
+
+SpecializationConstants SpecializationConstants::declared_by(const SpirvModule& module) const
+{
+	SpecializationConstants result;
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		if (module.declares_constant(ids[i]))
+		{
+			result.ids.push_back(ids[i]);
+			result.values.push_back(values[i]);
+		}
+	}
+	return result;
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constant_id, uint32_t value)
+{
+	// Setting a constant twice keeps the last value
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		if (ids[i] == constant_id)
+		{
+			values[i] = value;
+			return *this;
+		}
+	}
+	ids.push_back(constant_id);
+	values.push_back(value);
+	return *this;
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constant_id, int32_t value)
+{
+	return set(constant_id, (uint32_t)value);
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constant_id, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return set(constant_id, bits);
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constant_id, bool value)
+{
+	return set(constant_id, (uint32_t)(value ? 1 : 0));
+}
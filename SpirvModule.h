@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+
+#include "MappedFile.h"
+#include "ShaderSource.h"
+
+
+// Offline compiled SPIR-V shader module for GL 4.6 (ARB_gl_spirv), e.g.
+//   glslangValidator -G -o shader.vert.spv shader.vert
+// The driver skips GLSL parsing entirely, it only specializes and links the module.
+// Modules can come from a file (memory mapped) or be embedded with embed_shaders.py.
+class SpirvModule
+{
+public:
+	std::string entry_point = "main";
+
+	// Map a .spv file, prints the reason and returns false on failure
+	bool open(const char* path);
+
+	// Use a module embedded in the executable
+	bool load(const ShaderLibrary& library, const char* name);
+
+	const void* data() const { return code.data(); }
+	size_t size() const { return code.size(); }
+
+	// True if the module has a `layout(constant_id = constant_id)` declaration (a SpecId decoration)
+	bool declares_constant(uint32_t constant_id) const;
+
+private:
+	MappedFile file;
+	std::string_view code;
+	std::vector<uint32_t> spec_ids; // SpecId decorations, collected when the module is validated
+
+	bool validate(const std::string& name);
+	void find_spec_ids();
+};
+
+// Values for `layout(constant_id = N) const ...` declarations, applied when the
+// module is specialized. Variants differ only in these values instead of recompiling text.
+class SpecializationConstants
+{
+public:
+	SpecializationConstants& set(uint32_t constant_id, uint32_t value);
+	SpecializationConstants& set(uint32_t constant_id, int32_t value);
+	SpecializationConstants& set(uint32_t constant_id, float value);
+	SpecializationConstants& set(uint32_t constant_id, bool value);
+
+	// The constants module declares. Specializing with an id the module doesn't declare
+	// fails, so sets shared between stages go through this per stage.
+	SpecializationConstants declared_by(const SpirvModule& module) const;
+
+	GLuint count() const { return (GLuint)ids.size(); }
+	const GLuint* constant_ids() const { return ids.data(); }
+	const GLuint* constant_values() const { return values.data(); }
+
+private:
+	std::vector<GLuint> ids;
+	std::vector<GLuint> values; // raw 32 bit patterns
+};
@@ -0,0 +1,89 @@
+#include "StreamBuffer.h"
+
+#include <chrono>
+
+StreamBuffer::StreamBuffer(GLsizeiptr frame_size, unsigned int frames)
+	// Regions start on 256 byte boundaries so aligned allocations stay aligned in the whole buffer
+	: frame_size((frame_size + 255) / 256 * 256), frames(frames), fences(frames, nullptr)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &id);
+	glNamedBufferStorage(id, this->frame_size * frames, nullptr, flags);
+	mapped = (char*)glMapNamedBufferRange(id, 0, this->frame_size * frames, flags);
+
+	// Start on the last region so the first begin_frame() lands on region 0
+	frame = frames - 1;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	release();
+}
+
+void StreamBuffer::release()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	if (id != 0)
+	{
+		glUnmapNamedBuffer(id);
+		glDeleteBuffers(1, &id);
+		GLState::get().deleted_buffer(id);
+		id     = 0;
+		mapped = nullptr;
+	}
+}
+
+void StreamBuffer::begin_frame()
+{
+	frame = (frame + 1) % frames;
+	used  = 0;
+	counters.frames++;
+
+	GLsync& fence = fences[frame];
+	if (!fence)
+	{
+		return;
+	}
+
+	// Usually already signaled, only flush and block if the GPU is behind
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		counters.waits++;
+		const auto start = std::chrono::steady_clock::now();
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+		}
+		while (result == GL_TIMEOUT_EXPIRED);
+		counters.wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	const GLsizeiptr start = (used + alignment - 1) / alignment * alignment;
+	if (!mapped || start + size > frame_size)
+	{
+		counters.overflow++;
+		return Allocation();
+	}
+	used = start + size;
+
+	const GLintptr offset = (GLintptr)frame * frame_size + start;
+	return Allocation{ mapped + offset, offset };
+}
+
+void StreamBuffer::end_frame()
+{
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
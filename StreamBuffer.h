@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "GLState.h"
+
+
+// Ring buffer for data rewritten every frame (particles, UI, debug lines).
+// The buffer is persistently and coherently mapped once and split into one region per
+// frame in flight. The CPU writes straight into GPU visible memory, a fence per region
+// makes sure the GPU is done reading it before it is written again.
+//
+//	stream.begin_frame();
+//	StreamBuffer::Allocation lines = stream.allocate(count * sizeof(LineVertex));
+//	memcpy(lines.pointer, data, count * sizeof(LineVertex));
+//	... draw from stream.id at lines.offset ...
+//	stream.end_frame();
+class StreamBuffer
+{
+public:
+	struct Allocation
+	{
+		void* pointer = nullptr; // nullptr if the frame's region is full
+		GLintptr offset = 0;     // byte offset in the buffer, for binding/drawing
+	};
+
+	struct Stats
+	{
+		uint64_t frames   = 0;
+		uint64_t waits    = 0; // frames that had to wait for the GPU to release their region
+		uint64_t overflow = 0; // allocations that didn't fit
+		double wait_seconds = 0.0;
+	};
+
+	// frame_size bytes per frame, frames regions (3 covers the usual CPU/GPU latency)
+	StreamBuffer(GLsizeiptr frame_size, unsigned int frames = 3);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Move to the next region, waits only if the GPU is still reading it
+	void begin_frame();
+
+	// Reserve bytes in the current region
+	Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+	// Typed helper, count elements of T
+	template <typename T>
+	T* allocate(size_t count, GLintptr& offset)
+	{
+		Allocation allocation = allocate((GLsizeiptr)(count * sizeof(T)), (GLsizeiptr)alignof(T) < 4 ? 4 : (GLsizeiptr)alignof(T));
+		offset = allocation.offset;
+		return (T*)allocation.pointer;
+	}
+
+	// Fence the current region, call after the frame's draws were issued
+	void end_frame();
+
+	const Stats& stats() const { return counters; }
+
+	// Delete the GL objects now, e.g. before the context is destroyed
+	void release();
+
+	unsigned int id = 0;
+
+private:
+	GLsizeiptr frame_size;
+	unsigned int frames;
+	unsigned int frame = 0;
+	GLsizeiptr used = 0;
+	char* mapped = nullptr;
+	std::vector<GLsync> fences;
+	Stats counters;
+};
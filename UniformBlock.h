@@ -0,0 +1,182 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+#include "GLState.h"
+
+
+// C++ structs shared with GLSL uniform (std140) and storage (std430) blocks.
+//
+// Write the struct with the members in the same order as the GLSL block, then check
+// it against the layout rules at compile time:
+//
+//	struct FrameData
+//	{
+//		glm::mat4 view_projection;
+//		glm::vec3 camera_position;
+//		float time;
+//	};
+//	static_assert(BlockLayoutCheck<BlockLayout::std140>()
+//		.member<glm::mat4>(offsetof(FrameData, view_projection))
+//		.member<glm::vec3>(offsetof(FrameData, camera_position))
+//		.member<float>(offsetof(FrameData, time))
+//		.fits(sizeof(FrameData)));
+//
+// A member at the wrong offset fails to compile at its .member<>() line, add
+// padding (or reorder) until it matches what GLSL expects.
+
+enum class BlockLayout { std140, std430 };
+
+// GLSL bool is 4 bytes, use this instead of C++ bool in blocks
+using glsl_bool = uint32_t;
+
+// Base alignment and size of a type under a block layout.
+// Structs used as members (or array elements) declare `static constexpr size_t glsl_alignment`
+// with the largest alignment of their own members.
+template <BlockLayout Layout, typename T, typename = void>
+struct BlockRule
+{
+	static_assert(sizeof(T) == 0, "Type has no GLSL block layout rule (glm::mat3 and bool aren't supported, use glm::mat4 / glsl_bool)");
+};
+
+template <BlockLayout Layout, size_t Alignment, size_t Size>
+struct BlockRuleOf
+{
+	static constexpr size_t alignment = Alignment;
+	static constexpr size_t size      = Size;
+};
+
+template <BlockLayout L> struct BlockRule<L, float>      : BlockRuleOf<L, 4, 4> {};
+template <BlockLayout L> struct BlockRule<L, int32_t>    : BlockRuleOf<L, 4, 4> {};
+template <BlockLayout L> struct BlockRule<L, uint32_t>   : BlockRuleOf<L, 4, 4> {};
+template <BlockLayout L> struct BlockRule<L, glm::vec2>  : BlockRuleOf<L, 8, 8> {};
+template <BlockLayout L> struct BlockRule<L, glm::ivec2> : BlockRuleOf<L, 8, 8> {};
+template <BlockLayout L> struct BlockRule<L, glm::uvec2> : BlockRuleOf<L, 8, 8> {};
+template <BlockLayout L> struct BlockRule<L, glm::vec3>  : BlockRuleOf<L, 16, 12> {};
+template <BlockLayout L> struct BlockRule<L, glm::ivec3> : BlockRuleOf<L, 16, 12> {};
+template <BlockLayout L> struct BlockRule<L, glm::uvec3> : BlockRuleOf<L, 16, 12> {};
+template <BlockLayout L> struct BlockRule<L, glm::vec4>  : BlockRuleOf<L, 16, 16> {};
+template <BlockLayout L> struct BlockRule<L, glm::ivec4> : BlockRuleOf<L, 16, 16> {};
+template <BlockLayout L> struct BlockRule<L, glm::uvec4> : BlockRuleOf<L, 16, 16> {};
+template <BlockLayout L> struct BlockRule<L, glm::mat4>  : BlockRuleOf<L, 16, 64> {}; // 4 vec4 columns
+
+constexpr size_t block_round_up(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Structs: std140 rounds their alignment up to a vec4
+template <BlockLayout L, typename T>
+struct BlockRule<L, T, std::enable_if_t<std::is_class_v<T> && (T::glsl_alignment > 0)>>
+{
+	static constexpr size_t alignment = L == BlockLayout::std140
+		? block_round_up(T::glsl_alignment, 16)
+		: T::glsl_alignment;
+	static constexpr size_t size = sizeof(T);
+
+	static_assert(sizeof(T) % alignment == 0, "Struct must be padded to a multiple of its block alignment");
+};
+
+// Arrays: std140 rounds the element stride up to a vec4, C++ has no padding between elements
+template <BlockLayout L, typename T, size_t N>
+struct BlockRule<L, T[N]>
+{
+	static constexpr size_t alignment = L == BlockLayout::std140
+		? block_round_up(BlockRule<L, T>::alignment, 16)
+		: BlockRule<L, T>::alignment;
+	static constexpr size_t stride = block_round_up(BlockRule<L, T>::size, alignment);
+	static constexpr size_t size   = stride * N;
+
+	static_assert(stride == sizeof(T), "Array element stride differs from GLSL, use a padded element type (e.g. glm::vec4 instead of float in std140)");
+};
+
+// Walks the members of a struct in order, see the example at the top of this file
+template <BlockLayout Layout>
+class BlockLayoutCheck
+{
+public:
+	constexpr BlockLayoutCheck() = default;
+
+	template <typename T>
+	constexpr BlockLayoutCheck member(size_t offset) const
+	{
+		const size_t expected = block_round_up(end, BlockRule<Layout, T>::alignment);
+		if (offset != expected)
+		{
+			throw "Member offset doesn't match the GLSL block layout";
+		}
+
+		// Structs and arrays are whole multiples of their alignment, so the
+		// rounding GLSL does after them is already included in their size
+		BlockLayoutCheck next = *this;
+		next.end = offset + BlockRule<Layout, T>::size;
+		return next;
+	}
+
+	// True if a struct of this size holds every checked member
+	constexpr bool fits(size_t struct_size) const
+	{
+		return struct_size >= end;
+	}
+
+private:
+	size_t end = 0;
+};
+
+// GPU buffer holding one T, bound to a uniform (std140) or shader storage (std430) binding point.
+// Binding points are shared by all programs, so one upload serves every shader that declares
+// the block with the same `layout(binding = N)`.
+template <typename T>
+class BlockBuffer
+{
+public:
+	// target is GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+	explicit BlockBuffer(GLenum target = GL_UNIFORM_BUFFER)
+		: target(target)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Block structs are copied to the GPU byte for byte");
+		glCreateBuffers(1, &id);
+		glNamedBufferStorage(id, sizeof(T), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	~BlockBuffer()
+	{
+		release();
+	}
+
+	BlockBuffer(const BlockBuffer&) = delete;
+	BlockBuffer& operator=(const BlockBuffer&) = delete;
+
+	// Upload the whole block in one call
+	void update(const T& data) const
+	{
+		glNamedBufferSubData(id, 0, sizeof(T), &data);
+	}
+
+	// Bind to a binding point, stays bound until something else is bound there
+	void bind(GLuint binding) const
+	{
+		GLState::get().bind_buffer_base(target, binding, id);
+	}
+
+	// Delete the GL object now, e.g. before the context is destroyed
+	void release()
+	{
+		if (id != 0)
+		{
+			glDeleteBuffers(1, &id);
+			GLState::get().deleted_buffer(id);
+			id = 0;
+		}
+	}
+
+	unsigned int id = 0;
+
+private:
+	GLenum target;
+};
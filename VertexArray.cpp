@@ -0,0 +1,47 @@
+#include "VertexArray.h"
+
+VertexArray::VertexArray()
+{
+	glCreateVertexArrays(1, &id);
+}
+
+VertexArray::~VertexArray()
+{
+	release();
+}
+
+void VertexArray::release()
+{
+	if (id != 0)
+	{
+		glDeleteVertexArrays(1, &id);
+		GLState::get().deleted_vertex_array(id);
+		id = 0;
+	}
+}
+
+VertexArray::VertexArray(VertexArray&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		id       = other.id;
+		other.id = 0;
+	}
+	return *this;
+}
+
+void VertexArray::element_buffer(const Buffer& buffer)
+{
+	glVertexArrayElementBuffer(id, buffer.id);
+}
+
+void VertexArray::bind() const
+{
+	GLState::get().bind_vertex_array(id);
+}
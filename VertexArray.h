@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include "Buffer.h"
+#include "GLState.h"
+#include "VertexLayout.h"
+
+
+// Vertex array object set up through direct state access, nothing is bound while configuring it
+class VertexArray
+{
+public:
+	VertexArray();
+	~VertexArray();
+
+	VertexArray(const VertexArray&) = delete;
+	VertexArray& operator=(const VertexArray&) = delete;
+	VertexArray(VertexArray&& other) noexcept;
+	VertexArray& operator=(VertexArray&& other) noexcept;
+
+	// Attach buffer at binding_index with the attribute formats of Vertex (see VertexLayout.h)
+	template <typename Vertex>
+	void vertex_buffer(GLuint binding_index, const Buffer& buffer, GLintptr offset = 0)
+	{
+		setup_vertex_format<Vertex>(id, binding_index, buffer.id, offset);
+	}
+
+	// Per instance attributes: Instance's formats, advancing once every divisor instances
+	template <typename Instance>
+	void instance_buffer(GLuint binding_index, GLuint buffer, GLintptr offset = 0, GLuint divisor = 1)
+	{
+		setup_vertex_format<Instance>(id, binding_index, buffer, offset);
+		glVertexArrayBindingDivisor(id, binding_index, divisor);
+	}
+
+	// Same with a layout only known at runtime, e.g. from MeshFile
+	void vertex_buffer(GLuint binding_index, const Buffer& buffer, GLsizei stride,
+	                   const VertexAttribute* attributes, size_t attribute_count, GLintptr offset = 0)
+	{
+		setup_vertex_format(id, binding_index, buffer.id, offset, stride, attributes, attribute_count);
+	}
+
+	void element_buffer(const Buffer& buffer);
+
+	// Bind for drawing, skipped if it is already bound
+	void bind() const;
+
+	unsigned int id = 0;
+
+	// Delete the GL object now, e.g. before the context is destroyed
+	void release();
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <glad/glad.h> // Get OpenGL headers
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <glm/glm.hpp>
+
+
+// Vertex formats described once, next to the C++ vertex struct:
+//
+//	struct ColorVertex
+//	{
+//		glm::vec3 position;
+//		unorm8x4 color;
+//	};
+//	template <>
+//	struct VertexLayout<ColorVertex>
+//	{
+//		static constexpr VertexAttribute attributes[] = {
+//			VERTEX_ATTRIBUTE(ColorVertex, position, 0), // layout (location = 0)
+//			VERTEX_ATTRIBUTE(ColorVertex, color, 1),
+//		};
+//	};
+//
+// Component count, type, normalization, offset and stride all come from the struct,
+// setup_vertex_format<ColorVertex>(vao, ...) then emits the glVertexArrayAttrib* calls.
+
+// Compact component types, use them as vertex members like glm::vec3
+struct half2     { uint16_t x, y; };       // vec2, 16 bit floats
+struct half4     { uint16_t x, y, z, w; }; // vec4, 16 bit floats
+struct unorm8x4  { uint8_t r, g, b, a; };  // vec4 in [0, 1], e.g. colors
+struct snorm8x4  { int8_t x, y, z, w; };   // vec4 in [-1, 1]
+struct snorm16x2 { int16_t x, y; };        // vec2 in [-1, 1], e.g. octahedral normals
+struct snorm16x4 { int16_t x, y, z, w; };  // vec4 in [-1, 1], e.g. quantized positions
+struct snorm10x3 { uint32_t bits; };       // vec4 in [-1, 1], x/y/z 10 bits + 2 bit w, e.g. normals
+
+// How the shader sees an attribute
+enum class AttributeKind
+{
+	Float,   // glVertexArrayAttribFormat, ints can be normalized
+	Integer, // glVertexArrayAttribIFormat, ivec/uvec in the shader
+};
+
+struct VertexAttribute
+{
+	GLuint location;
+	GLint size;        // components
+	GLenum type;
+	GLboolean normalized;
+	AttributeKind kind;
+	GLuint offset;     // bytes from the start of the vertex
+	GLuint bytes;      // size of the member
+};
+
+// GL format of a vertex member type
+template <typename T>
+struct AttributeFormat
+{
+	static_assert(sizeof(T) == 0, "No vertex attribute format for this member type");
+};
+
+template <GLint Size, GLenum Type, GLboolean Normalized = GL_FALSE, AttributeKind Kind = AttributeKind::Float>
+struct AttributeFormatOf
+{
+	static constexpr GLint size            = Size;
+	static constexpr GLenum type           = Type;
+	static constexpr GLboolean normalized  = Normalized;
+	static constexpr AttributeKind kind    = Kind;
+};
+
+template <> struct AttributeFormat<float>      : AttributeFormatOf<1, GL_FLOAT> {};
+template <> struct AttributeFormat<glm::vec2>  : AttributeFormatOf<2, GL_FLOAT> {};
+template <> struct AttributeFormat<glm::vec3>  : AttributeFormatOf<3, GL_FLOAT> {};
+template <> struct AttributeFormat<glm::vec4>  : AttributeFormatOf<4, GL_FLOAT> {};
+template <> struct AttributeFormat<int32_t>    : AttributeFormatOf<1, GL_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<uint32_t>   : AttributeFormatOf<1, GL_UNSIGNED_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<glm::ivec2> : AttributeFormatOf<2, GL_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<glm::ivec3> : AttributeFormatOf<3, GL_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<glm::ivec4> : AttributeFormatOf<4, GL_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<glm::uvec2> : AttributeFormatOf<2, GL_UNSIGNED_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<glm::uvec3> : AttributeFormatOf<3, GL_UNSIGNED_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<glm::uvec4> : AttributeFormatOf<4, GL_UNSIGNED_INT, GL_FALSE, AttributeKind::Integer> {};
+template <> struct AttributeFormat<half2>      : AttributeFormatOf<2, GL_HALF_FLOAT> {};
+template <> struct AttributeFormat<half4>      : AttributeFormatOf<4, GL_HALF_FLOAT> {};
+template <> struct AttributeFormat<unorm8x4>   : AttributeFormatOf<4, GL_UNSIGNED_BYTE, GL_TRUE> {};
+template <> struct AttributeFormat<snorm8x4>   : AttributeFormatOf<4, GL_BYTE, GL_TRUE> {};
+template <> struct AttributeFormat<snorm16x2>  : AttributeFormatOf<2, GL_SHORT, GL_TRUE> {};
+template <> struct AttributeFormat<snorm16x4>  : AttributeFormatOf<4, GL_SHORT, GL_TRUE> {};
+template <> struct AttributeFormat<snorm10x3>  : AttributeFormatOf<4, GL_INT_2_10_10_10_REV, GL_TRUE> {};
+
+template <typename T>
+constexpr VertexAttribute make_vertex_attribute(GLuint location, size_t offset)
+{
+	return VertexAttribute{
+		location,
+		AttributeFormat<T>::size,
+		AttributeFormat<T>::type,
+		AttributeFormat<T>::normalized,
+		AttributeFormat<T>::kind,
+		(GLuint)offset,
+		(GLuint)sizeof(T),
+	};
+}
+
+// Describe one member of Vertex as the attribute at location
+#define VERTEX_ATTRIBUTE(Vertex, member, location) \
+	make_vertex_attribute<decltype(Vertex::member)>((location), offsetof(Vertex, member))
+
+// Specialize with `static constexpr VertexAttribute attributes[]` for each vertex struct
+template <typename Vertex>
+struct VertexLayout;
+
+// Compile time sanity checks of a layout
+template <typename Vertex>
+constexpr bool vertex_layout_valid()
+{
+	constexpr size_t count = sizeof(VertexLayout<Vertex>::attributes) / sizeof(VertexAttribute);
+	for (size_t i = 0; i < count; i++)
+	{
+		const VertexAttribute& attribute = VertexLayout<Vertex>::attributes[i];
+		// GL wants attribute offsets aligned to 4 bytes
+		if (attribute.offset % 4 != 0 || attribute.offset + attribute.bytes > sizeof(Vertex))
+		{
+			return false;
+		}
+		for (size_t j = 0; j < i; j++)
+		{
+			if (VertexLayout<Vertex>::attributes[j].location == attribute.location)
+			{
+				return false;
+			}
+		}
+	}
+	return sizeof(Vertex) % 4 == 0;
+}
+
+// Set up attribute formats described at runtime (e.g. read from a cooked mesh file)
+// and attach buffer at binding_index
+inline void setup_vertex_format(GLuint vao, GLuint binding_index, GLuint buffer, GLintptr offset, GLsizei stride,
+                                const VertexAttribute* attributes, size_t attribute_count)
+{
+	glVertexArrayVertexBuffer(vao, binding_index, buffer, offset, stride);
+	for (size_t i = 0; i < attribute_count; i++)
+	{
+		const VertexAttribute& attribute = attributes[i];
+		glEnableVertexArrayAttrib(vao, attribute.location);
+		if (attribute.kind == AttributeKind::Integer)
+		{
+			glVertexArrayAttribIFormat(vao, attribute.location, attribute.size, attribute.type, attribute.offset);
+		}
+		else
+		{
+			glVertexArrayAttribFormat(vao, attribute.location, attribute.size, attribute.type,
+			                          attribute.normalized, attribute.offset);
+		}
+		glVertexArrayAttribBinding(vao, attribute.location, binding_index);
+	}
+}
+
+// Set up the attribute formats of vao for Vertex and attach buffer at binding_index.
+// Several vertex streams can be combined by using different binding indices.
+template <typename Vertex>
+void setup_vertex_format(GLuint vao, GLuint binding_index, GLuint buffer, GLintptr offset = 0)
+{
+	static_assert(vertex_layout_valid<Vertex>(), "Vertex layout has misaligned, overlapping or duplicate attributes");
+
+	setup_vertex_format(vao, binding_index, buffer, offset, (GLsizei)sizeof(Vertex),
+	                    VertexLayout<Vertex>::attributes, std::size(VertexLayout<Vertex>::attributes));
+}
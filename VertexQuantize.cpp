@@ -0,0 +1,279 @@
+#include "VertexQuantize.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUANTIZE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__F16C__) || defined(__AVX2__)
+#define QUANTIZE_F16C
+#include <immintrin.h>
+#endif
+
+uint16_t float_to_half(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const int32_t magnitude = (int32_t)(bits & 0x7fffffff);
+
+	// Rebias the exponent (127 -> 15) and round the mantissa to nearest even
+	int32_t half = (magnitude - (112 << 23) + 0xfff + ((magnitude >> 13) & 1)) >> 13;
+	// Too small for a normal half, flush to zero
+	half = magnitude < (113 << 23) ? 0 : half;
+	// Too large, infinity
+	half = magnitude >= (143 << 23) ? 0x7c00 : half;
+	// NaN stays NaN
+	half = magnitude > (255 << 23) ? 0x7e00 : half;
+
+	return (uint16_t)(sign | (uint32_t)half);
+}
+
+float half_to_float(uint16_t value)
+{
+	const uint32_t sign     = (uint32_t)(value & 0x8000) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1f;
+	const uint32_t mantissa = value & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13); // inf / NaN
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	else if (mantissa != 0)
+	{
+		// Denormal, scale it into a normal float
+		float result = std::ldexp((float)mantissa, -24);
+		return sign ? -result : result;
+	}
+	else
+	{
+		bits = sign;
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void convert_half(const float* input, uint16_t* output, size_t count)
+{
+	size_t i = 0;
+#if defined(QUANTIZE_F16C)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i half = _mm_cvtps_ph(_mm_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storel_epi64((__m128i*)(output + i), half);
+	}
+#elif defined(QUANTIZE_SSE2)
+	// Same bit manipulation as float_to_half, four at a time
+	const __m128i abs_mask   = _mm_set1_epi32(0x7fffffff);
+	const __m128i rebias     = _mm_set1_epi32((112 << 23) - 0xfff);
+	const __m128i one        = _mm_set1_epi32(1);
+	const __m128i min_normal = _mm_set1_epi32(113 << 23);
+	const __m128i max_finite = _mm_set1_epi32((143 << 23) - 1);
+	const __m128i max_inf    = _mm_set1_epi32(255 << 23);
+	const __m128i infinity   = _mm_set1_epi32(0x7c00);
+	const __m128i nan        = _mm_set1_epi32(0x7e00);
+	const __m128i bias16     = _mm_set1_epi32(0x8000);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i bits      = _mm_castps_si128(_mm_loadu_ps(input + i));
+		__m128i magnitude = _mm_and_si128(bits, abs_mask);
+		__m128i sign      = _mm_and_si128(_mm_srli_epi32(bits, 16), bias16);
+
+		__m128i odd  = _mm_and_si128(_mm_srli_epi32(magnitude, 13), one);
+		__m128i half = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(magnitude, rebias), odd), 13);
+		half = _mm_andnot_si128(_mm_cmplt_epi32(magnitude, min_normal), half);
+
+		__m128i overflow = _mm_cmpgt_epi32(magnitude, max_finite);
+		half = _mm_or_si128(_mm_andnot_si128(overflow, half), _mm_and_si128(overflow, infinity));
+		__m128i is_nan = _mm_cmpgt_epi32(magnitude, max_inf);
+		half = _mm_or_si128(_mm_andnot_si128(is_nan, half), _mm_and_si128(is_nan, nan));
+		half = _mm_or_si128(half, sign);
+
+		// No unsigned 32 -> 16 pack in SSE2, shift into signed range and back
+		__m128i packed = _mm_packs_epi32(_mm_sub_epi32(half, bias16), _mm_sub_epi32(half, bias16));
+		packed = _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000));
+		_mm_storel_epi64((__m128i*)(output + i), packed);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		output[i] = float_to_half(input[i]);
+	}
+}
+
+void convert_unorm8(const float* input, uint8_t* output, size_t count)
+{
+	size_t i = 0;
+#if defined(QUANTIZE_SSE2)
+	const __m128 zero  = _mm_setzero_ps();
+	const __m128 one   = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i), zero), one);
+		__m128i integer = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(integer, integer), _mm_setzero_si128());
+		int bytes = _mm_cvtsi128_si32(packed);
+		memcpy(output + i, &bytes, 4);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const float value = std::min(std::max(input[i], 0.0f), 1.0f);
+		output[i] = (uint8_t)std::nearbyint(value * 255.0f);
+	}
+}
+
+void convert_snorm16(const float* input, int16_t* output, size_t count)
+{
+	size_t i = 0;
+#if defined(QUANTIZE_SSE2)
+	const __m128 minimum = _mm_set1_ps(-1.0f);
+	const __m128 maximum = _mm_set1_ps(1.0f);
+	const __m128 scale   = _mm_set1_ps(32767.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i), minimum), maximum);
+		__m128i integer = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+		_mm_storel_epi64((__m128i*)(output + i), _mm_packs_epi32(integer, integer));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const float value = std::min(std::max(input[i], -1.0f), 1.0f);
+		output[i] = (int16_t)std::nearbyint(value * 32767.0f);
+	}
+}
+
+namespace
+{
+	float sign_not_zero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Octahedral projection of a unit vector onto [-1, 1]^2
+	void octahedral(const glm::vec3& normal, float& u, float& v)
+	{
+		const float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+		if (length == 0.0f)
+		{
+			u = 0.0f;
+			v = 0.0f;
+			return;
+		}
+		u = normal.x / length;
+		v = normal.y / length;
+		if (normal.z < 0.0f)
+		{
+			// Fold the lower hemisphere over the diagonals
+			const float folded_u = (1.0f - std::fabs(v)) * sign_not_zero(u);
+			const float folded_v = (1.0f - std::fabs(u)) * sign_not_zero(v);
+			u = folded_u;
+			v = folded_v;
+		}
+	}
+}
+
+snorm16x2 encode_octahedral(const glm::vec3& normal)
+{
+	float uv[2];
+	octahedral(normal, uv[0], uv[1]);
+	int16_t packed[2];
+	convert_snorm16(uv, packed, 2);
+	return snorm16x2{ packed[0], packed[1] };
+}
+
+snorm10x3 pack_snorm10(const glm::vec3& normal)
+{
+	auto component = [](float value)
+	{
+		const float clamped = std::min(std::max(value, -1.0f), 1.0f);
+		return (uint32_t)((int32_t)std::nearbyint(clamped * 511.0f) & 0x3ff);
+	};
+	return snorm10x3{ component(normal.x) | (component(normal.y) << 10) | (component(normal.z) << 20) };
+}
+
+PositionQuantization PositionQuantization::fit(const float* positions, size_t count)
+{
+	if (count == 0)
+	{
+		return PositionQuantization{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+	}
+
+	float minimum[3] = { positions[0], positions[1], positions[2] };
+	float maximum[3] = { positions[0], positions[1], positions[2] };
+	for (size_t i = 1; i < count; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minimum[axis] = std::min(minimum[axis], positions[i * 3 + axis]);
+			maximum[axis] = std::max(maximum[axis], positions[i * 3 + axis]);
+		}
+	}
+
+	float offset[3];
+	float scale[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		offset[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+		scale[axis]  = (maximum[axis] - minimum[axis]) * 0.5f;
+		// Flat axis, anything non-zero keeps the division finite
+		scale[axis]  = scale[axis] > 0.0f ? scale[axis] : 1.0f;
+	}
+	return PositionQuantization{ { offset[0], offset[1], offset[2] }, { scale[0], scale[1], scale[2] } };
+}
+
+std::vector<PackedVertex> quantize_vertices(const float* positions, const float* colors, const float* normals,
+                                            size_t count, PositionQuantization& decode)
+{
+	decode = PositionQuantization::fit(positions, count);
+
+	// Normalize into [-1, 1] then convert whole streams at once
+	std::vector<float> normalized(count * 3);
+	const float offset[3]  = { decode.offset.x, decode.offset.y, decode.offset.z };
+	const float inverse[3] = { 1.0f / decode.scale.x, 1.0f / decode.scale.y, 1.0f / decode.scale.z };
+	for (size_t i = 0; i < count * 3; i++)
+	{
+		normalized[i] = (positions[i] - offset[i % 3]) * inverse[i % 3];
+	}
+	std::vector<int16_t> packed_positions(count * 3);
+	convert_snorm16(normalized.data(), packed_positions.data(), count * 3);
+
+	std::vector<uint8_t> packed_colors(count * 3, 255);
+	if (colors)
+	{
+		convert_unorm8(colors, packed_colors.data(), count * 3);
+	}
+
+	std::vector<float> octahedral_normals(count * 2, 0.0f);
+	if (normals)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const glm::vec3 normal{ normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2] };
+			octahedral(normal, octahedral_normals[i * 2], octahedral_normals[i * 2 + 1]);
+		}
+	}
+	std::vector<int16_t> packed_normals(count * 2);
+	convert_snorm16(octahedral_normals.data(), packed_normals.data(), count * 2);
+
+	std::vector<PackedVertex> vertices(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		PackedVertex& vertex = vertices[i];
+		vertex.position = { packed_positions[i * 3], packed_positions[i * 3 + 1], packed_positions[i * 3 + 2], 32767 };
+		vertex.color    = { packed_colors[i * 3], packed_colors[i * 3 + 1], packed_colors[i * 3 + 2], 255 };
+		vertex.normal   = { packed_normals[i * 2], packed_normals[i * 2 + 1] };
+	}
+	return vertices;
+}
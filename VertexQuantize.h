@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "VertexLayout.h"
+
+
+// Converts float vertex data into the compact formats from VertexLayout.h.
+// The bulk conversions use SSE2 (and F16C for halves when the compiler targets AVX2),
+// with scalar fallbacks that produce the same results. All paths round to nearest even;
+// without F16C, values too small for a normal half are flushed to zero.
+
+// Bulk conversions over count floats
+void convert_half(const float* input, uint16_t* output, size_t count);
+void convert_unorm8(const float* input, uint8_t* output, size_t count);   // clamps to [0, 1]
+void convert_snorm16(const float* input, int16_t* output, size_t count);  // clamps to [-1, 1]
+
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+// Octahedral encoding of a unit normal into two snorm16, decoded by oct_decode in vertex_decode.glsl
+snorm16x2 encode_octahedral(const glm::vec3& normal);
+// Unit normal into GL_INT_2_10_10_10_REV, w = 0
+snorm10x3 pack_snorm10(const glm::vec3& normal);
+
+// snorm16 positions cover the mesh bounds: position = offset + scale * quantized.
+// Pass these to the shader as uPositionOffset / uPositionScale (QUANTIZED_POSITION).
+struct PositionQuantization
+{
+	glm::vec3 offset;
+	glm::vec3 scale;
+
+	// Fit the bounds of count xyz positions
+	static PositionQuantization fit(const float* positions, size_t count);
+};
+
+// 16 bytes per vertex instead of 36 for float position, color and normal
+struct PackedVertex
+{
+	snorm16x4 position; // xyz, w = 1
+	unorm8x4 color;
+	snorm16x2 normal;   // octahedral
+};
+
+template <>
+struct VertexLayout<PackedVertex>
+{
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(PackedVertex, position, 0),
+		VERTEX_ATTRIBUTE(PackedVertex, color, 1),
+		VERTEX_ATTRIBUTE(PackedVertex, normal, 2),
+	};
+};
+
+// Quantize a float mesh given as separate xyz position, rgb color and xyz normal streams.
+// colors and normals may be null (white / +z). decode receives the position bounds.
+std::vector<PackedVertex> quantize_vertices(const float* positions, const float* colors, const float* normals,
+                                            size_t count, PositionQuantization& decode);
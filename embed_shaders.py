@@ -0,0 +1,68 @@
+"""Embed shader sources into a C++ header as constexpr byte arrays.
+
+usage: embed_shaders.py <output header> <shader file>...
+
+Each file is registered in embedded_shaders under its file name so Shader can be
+built without touching the disk. The header is only rewritten when its content
+changes, so unchanged shaders don't trigger a rebuild.
+"""
+import os
+import re
+import sys
+
+
+def symbol_for(name):
+    return "embedded_" + re.sub(r"[^0-9A-Za-z_]", "_", name)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+
+    output = sys.argv[1]
+    lines = [
+        "// Generated by embed_shaders.py, do not edit.",
+        "#pragma once",
+        "",
+        '#include "ShaderSource.h"',
+        "",
+    ]
+
+    entries = []
+    for path in sys.argv[2:]:
+        name = os.path.basename(path)
+        with open(path, "rb") as f:
+            data = f.read()
+        symbol = symbol_for(name)
+        lines.append("constexpr char %s[] = {" % symbol)
+        for start in range(0, len(data), 16):
+            chunk = data[start:start + 16]
+            lines.append("\t" + ", ".join("0x%02x" % b for b in chunk) + ",")
+        lines.append("\t0x00")
+        lines.append("};")
+        lines.append("")
+        entries.append('\t{ "%s", std::string_view(%s, %d) },' % (name, symbol, len(data)))
+
+    lines.append("constexpr EmbeddedShader embedded_shader_list[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("")
+    lines.append("constexpr ShaderLibrary embedded_shaders{ embedded_shader_list, %d };" % len(entries))
+    content = "\n".join(lines) + "\n"
+
+    if os.path.exists(output):
+        with open(output, "r", newline="") as f:
+            if f.read() == content:
+                return 0
+
+    directory = os.path.dirname(output)
+    if directory:
+        os.makedirs(directory, exist_ok=True)
+    with open(output, "w", newline="") as f:
+        f.write(content)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,41 +1,77 @@
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <filesystem>
+#include <vector>
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
 #include <glm/glm.hpp>
+#include "Bvh.h"
+#include "FrustumCulling.h"
+#include "GeometryArena.h"
+#include "GpuCulling.h"
+#include "GLState.h"
+#include "Instancing.h"
+#include "LodSelection.h"
+#include "MeshFile.h"
+#include "MeshImporter.h"
+#include "MultiDraw.h"
+#include "RenderQueue.h"
 #include "Shader.h"
+#include "ShaderBuilder.h"
+#include "ShaderWatcher.h"
+#include "VertexLayout.h"
+#include "VertexQuantize.h"
+#include "EmbeddedShaders.h" // Generated by embed_shaders.py before each build
 
 GLFWwindow* win;
 
-// gl:	configure buffer.
-//	  - store vertex data in memory of graphics
-//		card managed by buffer object VBO.
-// --------------------------------------------
-float vertices[] = {
-	0.5f, -0.5f, 0.0f,  // bottom right
-	-0.5f, 0.5f, 0.0f,  // top left
-	0.5f, 0.5f, 0.0f,   // top right
-	-0.5f, -0.5f, 0.0f, // bottom left
+// Interleaved position + color, attributes are derived from the struct
+struct ColorVertex
+{
+	glm::vec3 position;
+	glm::vec3 color;
 };
 
-unsigned int indices[] = {
-	0, 1, 2,
-	0, 1, 3
+template <>
+struct VertexLayout<ColorVertex>
+{
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(ColorVertex, position, 0), // aPos
+		VERTEX_ATTRIBUTE(ColorVertex, color, 1),    // aColor
+	};
 };
 
-float vertices_one[] = {
-	0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f,  // bottom right
-	-0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, // bottom left
-	0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f    // middle top
+ColorVertex vertices_one[] = {
+	{ { 0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },  // bottom right
+	{ { -0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f } }, // bottom left
+	{ { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f } }    // middle top
 };
 
 unsigned int indices_one[] = {
 	0, 1, 2
 };
 
+ColorVertex vertices_quad[] = {
+	{ { 0.4f, 0.4f, 0.0f }, { 1.0f, 1.0f, 0.0f } },   // top right
+	{ { 0.4f, -0.4f, 0.0f }, { 0.0f, 1.0f, 1.0f } },  // bottom right
+	{ { -0.4f, -0.4f, 0.0f }, { 1.0f, 0.0f, 1.0f } }, // bottom left
+	{ { -0.4f, 0.4f, 0.0f }, { 1.0f, 1.0f, 1.0f } }   // top left
+};
+
+unsigned int indices_quad[] = {
+	0, 1, 3,
+	1, 2, 3
+};
+
 
 void process_input(GLFWwindow* window);
+bool load_mesh(const std::string& path, MeshFile& mesh);
+bool quantize_model(const MeshFile& model, Buffer& vertices, PositionQuantization& decode);
 void frame_buffer_size_callback(GLFWwindow* window, int width, int height);
 void error_callback(int error, const char* msg);
 
@@ -65,6 +101,12 @@ int init()
 	// Width, Height, Monitor to fullscreen, Window to share resources with
 	win = glfwCreateWindow(800, 600, "Hello, World!", nullptr, nullptr);
 	if (!win)
+	{
+		// Nothing here needs 4.6, e.g. Mesa's llvmpipe stops at 4.5
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		win = glfwCreateWindow(800, 600, "Hello, World!", nullptr, nullptr);
+	}
+	if (!win)
 	{
 		std::cout << "Failed to create window" << std::endl;
 		glfwTerminate();
@@ -96,7 +138,27 @@ int main(int argc, char** argv)
 
 	// GLSL: vertex & fragment shader setup
 	// -------------------
-	Shader shader(SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag");
+	// Built in the background, the render loop draws once it is ready
+#ifdef SHADER_FILE_OVERRIDE
+	// Development: build from the source tree and rebuild when the files are saved
+	ProgramCache program_cache(SOLUTION_DIR "/shader_cache");
+	ShaderBuilder shader_builder((GLADloadproc)glfwGetProcAddress, &program_cache);
+	PendingShader shader = shader_builder.request(SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag");
+	PendingShader instanced_shader = shader_builder.request(SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag", { "INSTANCED" });
+	PendingShader model_shader = shader_builder.request(SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag", { "QUANTIZED_POSITION" });
+
+	ShaderWatcher shader_watcher(shader_builder);
+	shader_watcher.watch(shader, SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag");
+	shader_watcher.watch(instanced_shader, SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag", { "INSTANCED" });
+	shader_watcher.watch(model_shader, SOLUTION_DIR "/shader.vert", SOLUTION_DIR "/shader.frag", { "QUANTIZED_POSITION" });
+#else
+	// Sources are compiled into the executable, no shader files are opened
+	ProgramCache program_cache("shader_cache");
+	ShaderBuilder shader_builder((GLADloadproc)glfwGetProcAddress, &program_cache);
+	PendingShader shader = shader_builder.request(embedded_shaders, "shader.vert", "shader.frag");
+	PendingShader instanced_shader = shader_builder.request(embedded_shaders, "shader.vert", "shader.frag", { "INSTANCED" });
+	PendingShader model_shader = shader_builder.request(embedded_shaders, "shader.vert", "shader.frag", { "QUANTIZED_POSITION" });
+#endif
 
 	/*
 	 * Vertex data has been given to GPU and told the GPU how to process the
@@ -105,69 +167,135 @@ int main(int argc, char** argv)
 	 * to vertex shader's attributes.
 	 * Link the vertex data in memory to the shaders.
 	 */
-	// Generate unique ID for buffer object
-	unsigned int vbo;
-	glGenBuffers(1, &vbo); // Generate buffer object ID and store it in VBO. (Optionally >1 and give array as 2nd arg)
-	unsigned int ebo;
-	glGenBuffers(1, &ebo);
-	unsigned int vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	// Linking Vertex Attributes
-	// -------------------------
-
-	// Vertices array:
-	// 3 vertices, xyz each, each float is 4 bytes
-	// 36 bytes total, 12B per vertex, 4 per attrib
-
-	// 0: Vertex shader said position vertex attrib is at location=0 (Set location of vertex attrib to 0)
-	// 3: Size of the vertex attrib (vec3=3 values)
-	// GL_FLOAT: type of the data
-	// GL_FALSE: Do we want to normalize the data? Not relevant rn
-	// 3*sizeof(float): Space between consecutive vertex attribs (A set of position data is 3 times the size of a float away)
-	//		-> Or give it 0, to let OpenGL determine stride but only works for tightly packed values
-	// (void*)0: Offset of where position data begins in buffer. 0 for now
-	//glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	//glEnableVertexAttribArray(0); // Give vertex attrib location
-
-	// VBO is still bound so vertex attrib 0 is now associated with its vertex data
+	// Every mesh of this vertex format lives in the arena's shared buffers, filled without binds.
+	// Meshes here are small, so indices are stored as 16 bit.
+	GeometryArena arena = GeometryArena::create<ColorVertex>(1 << 16, 3 << 16, GL_UNSIGNED_SHORT);
+	GeometryArena::Mesh triangle = arena.add(vertices_one, (uint32_t)std::size(vertices_one),
+	                                         indices_one, (uint32_t)std::size(indices_one));
+	GeometryArena::Mesh quad = arena.add(vertices_quad, (uint32_t)std::size(vertices_quad),
+	                                     indices_quad, (uint32_t)std::size(indices_quad));
 
 	// Vertex Array Object
-	// Bound just like a vertex buffer object, and any subsequent
-	// calls with be stored in the VAO. Reduces code duplication since
-	// you only have to make those calls once, can just bind the 
-	// corresponding VAO for the set of bindings. (Typically required too)
+	// The arena's VAO stores the attribute formats and which buffers they read from,
+	// so drawing any of its meshes only has to bind that one VAO.
 	// -------------------------------------------------------------------
 
 
-	// ..:: Initialization code done only once unless object frequently changes ::..
-	// 1. Bind VAO
-	// 2. Copy vertices array in a buffer for OpenGL to use
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices_one), vertices_one, GL_STATIC_DRAW);
-	// Give buffer object bound to GL_ARRAY_BUFFER the vertex data
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices_one), indices_one, GL_STATIC_DRAW);
-
-	// 3. Set vertex attribute pointers
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-	                      /* Stride:*/6 * sizeof(float),
-	                      /* Offset:*/(void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-	                      /* Stride:*/6 * sizeof(float),
-	                      /* Offset:*/(void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	// Per instance transforms and colors are streamed each frame, every mesh of a
+	// material bucket goes out in one multi draw call
+	const int grid_size = 100;
+	const uint32_t grid_material = 0;
+	MultiDrawBatcher<> instances(arena, grid_size * grid_size, 64);
+
+	// The grid doesn't move, its instances and bounding spheres are set up once and
+	// only the cells inside the view are handed to the batcher each frame
+	std::vector<InstanceData> grid_instances;
+	std::vector<GeometryArena::Mesh> grid_meshes;
+	SphereBounds grid_bounds;
+	Bvh grid_bvh; // same cells for picking, object ids match the cell index
+	const float spacing = 2.0f / grid_size;
+	for (int y = 0; y < grid_size; y++)
+	{
+		for (int x = 0; x < grid_size; x++)
+		{
+			InstanceData instance;
+			instance.row0 = glm::vec4(spacing * 0.8f, 0.0f, 0.0f, -1.0f + spacing * (x + 0.5f));
+			instance.row1 = glm::vec4(0.0f, spacing * 0.8f, 0.0f, -1.0f + spacing * (y + 0.5f));
+			instance.row2 = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+			instance.params = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+			instance.color = { (uint8_t)(x * 255 / grid_size), (uint8_t)(y * 255 / grid_size), 255, 255 };
+			grid_instances.push_back(instance);
+			grid_meshes.push_back((x + y) % 2 ? quad : triangle);
+			// Both meshes fit in a circle of radius 0.75 before the 0.8 * spacing scale
+			grid_bounds.add(glm::vec4(instance.row0.w, instance.row1.w, 0.0f, 0.75f * 0.8f * spacing));
+			grid_bvh.insert(Aabb::from_sphere(grid_bounds.get((uint32_t)grid_bvh.size())));
+		}
+	}
+	grid_bvh.build();
+	bool was_clicked = false;
+	std::vector<uint32_t> visible_cells;
+	// Clip space is world space here, the view is the identity
+	const Frustum view_frustum = Frustum::from_matrix(glm::mat4(1.0f));
+
+	// With GL 4.5 (cull.comp's version) the grid is culled on the GPU instead, C switches
+	// between both. Without a depth buffer there is no pyramid, only the frustum is tested.
+	std::unique_ptr<ComputeShader> cull_program;
+	std::unique_ptr<GpuCuller> gpu_culler;
+	GLint gl_major = 0, gl_minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &gl_major);
+	glGetIntegerv(GL_MINOR_VERSION, &gl_minor);
+	if (gl_major > 4 || (gl_major == 4 && gl_minor >= 5))
+	{
+#ifdef SHADER_FILE_OVERRIDE
+		cull_program = std::make_unique<ComputeShader>(SOLUTION_DIR "/cull.comp", &program_cache);
+#else
+		cull_program = std::make_unique<ComputeShader>(embedded_shaders, "cull.comp", &program_cache);
+#endif
+		if (cull_program->id != 0)
+		{
+			gpu_culler = std::make_unique<GpuCuller>(arena, *cull_program, (uint32_t)grid_instances.size());
+			for (size_t cell = 0; cell < grid_instances.size(); cell++)
+			{
+				gpu_culler->add(grid_meshes[cell], grid_bounds.get((uint32_t)cell), grid_instances[cell]);
+			}
+		}
+	}
+	bool gpu_culling = gpu_culler != nullptr;
+	bool was_toggled = false;
+
+	// Optional model from the command line, cooked once and then loaded straight into buffers.
+	// Its vertices are packed to 16 bytes when it has float positions, see quantize_model().
+	MeshFile model;
+	Buffer model_vertices, model_indices;
+	VertexArray model_vao;
+	PositionQuantization model_decode;
+	const bool has_model = argc > 1 && load_mesh(argv[1], model) && model.lod_count() > 0;
+	const bool model_quantized = has_model && quantize_model(model, model_vertices, model_decode);
+	if (has_model)
+	{
+		model_indices = model.index_buffer();
+		if (model_quantized)
+		{
+			model_vao.vertex_buffer<PackedVertex>(0, model_vertices);
+			model_vao.element_buffer(model_indices);
+		}
+		else
+		{
+			model_vertices = model.vertex_buffer();
+			model.setup(model_vao, model_vertices, model_indices);
+		}
+	}
 
+	// No camera yet: levels are picked for a fixed 60 degree camera on the +z axis of the
+	// model, Up/Down move it closer and farther. The level drawn last frame is kept for the
+	// hysteresis.
+	float model_center[3] = {};
+	float model_radius = 0.0f;
+	if (has_model)
+	{
+		const MeshFileHeader& header = model.header();
+		float radius2 = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			model_center[axis] = (header.bounds_min[axis] + header.bounds_max[axis]) * 0.5f;
+			const float half = (header.bounds_max[axis] - header.bounds_min[axis]) * 0.5f;
+			radius2 += half * half;
+		}
+		model_radius = std::sqrt(radius2);
+	}
+	float lod_camera_z = model_center[2] + model_radius * 3.0f;
+	uint32_t model_lod = ~0u; // none drawn yet
 
 	/*
 	 * First Generate/configure all VAOs (and required VBO and attrib pointers) and store for later.
-	 * To draw, take the corresponding VAO, bind it, then daw the object and unbind the VAO again.
+	 * To draw, take the corresponding VAO, bind it, then draw the object.
 	 *
 	 */
 
+	RenderQueue render_queue;
+	GLState& gl_state = GLState::get();
+	double stats_time = glfwGetTime();
+
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	// render loop
 	// -----------
@@ -179,29 +307,227 @@ int main(int argc, char** argv)
 		// Rendering commands
 		// ------------------
 		// Sets clear color and clears screen in buffer
-		glClearColor(0.9f, 0.9f, 0.9f, 1.0f); // Sets context's clear color attrib
+		gl_state.clear_color(0.9f, 0.9f, 0.9f, 1.0f); // Sets context's clear color attrib (only if it changed)
 		glClear(GL_COLOR_BUFFER_BIT);         // Uses context's clear color attrib
 
 
+		// Pick up finished shader builds and reloads without waiting on the compiler
+#ifdef SHADER_FILE_OVERRIDE
+		shader_watcher.update();
+#endif
+		shader_builder.update();
+
 		// Rendering commands ...
 		// To draw object now, only have to use these with the VAO initialized:
-		shader.use();
-
-		glBindVertexArray(vao);
-		//glDrawArrays(GL_TRIANGLES, 0, 6); // 0-Starting index, 3-# of vertices
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-		glBindVertexArray(0); // Unbind the vertex array
+		// Draws go through the queue and come out sorted by program, material and VAO
+		if (Shader* program = shader.get())
+		{
+			//glDrawArrays(GL_TRIANGLES, 0, 6); // 0-Starting index, 3-# of vertices
+			render_queue.submit(RenderQueue::opaque_key(0, program->id, 0, triangle, 0.0f),
+			                    RenderQueue::arena_draw(program->id, arena, triangle));
+
+			// The packed model needs its own variant that decodes the positions
+			Shader* model_program = model_quantized ? model_shader.get() : program;
+			if (has_model && model_program)
+			{
+				if (model_quantized)
+				{
+					model_program->set("uPositionOffset", model_decode.offset);
+					model_program->set("uPositionScale", model_decode.scale);
+				}
+
+				int framebuffer_width, framebuffer_height;
+				glfwGetFramebufferSize(win, &framebuffer_width, &framebuffer_height);
+				const LodView lod_view = LodView::perspective(1.0472f, (float)framebuffer_height);
+				const float dx = model_center[0], dy = model_center[1], dz = model_center[2] - lod_camera_z;
+				const float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - model_radius;
+				model_lod = select_lod(model.lods(), model.lod_count(), distance, lod_view, model_lod);
+
+				// Not an arena mesh, its VAO id stands in for the mesh in the key
+				const MeshLod& lod = model.lods()[model_lod];
+				RenderQueue::Draw draw;
+				draw.program      = model_program->id;
+				draw.vao          = model_vao.id;
+				draw.index_type   = model.index_type();
+				draw.index_count  = (GLsizei)lod.index_count;
+				draw.index_offset = (uintptr_t)lod.first_index * model.index_size();
+				render_queue.submit(RenderQueue::opaque_key(0, model_program->id, 0, model_vao.id, 0.0f), draw);
+			}
+		}
+		render_queue.flush();
+
+		// Up to 10,000 small triangles and quads in a single multi draw
+		if (Shader* program = instanced_shader.get(); program && gpu_culling)
+		{
+			gpu_culler->cull(glm::mat4(1.0f));
+			program->use();
+			gpu_culler->draw();
+		}
+		else if (program)
+		{
+			program->use();
+			const size_t visible = cull_spheres(grid_bounds, view_frustum, visible_cells);
+			for (size_t i = 0; i < visible; i++)
+			{
+				const uint32_t cell = visible_cells[i];
+				instances.add(grid_material, grid_meshes[cell], grid_instances[cell]);
+			}
+			instances.draw(grid_material);
+		}
+		instances.end_frame();
+
+		// Close holes left by removed meshes a little each frame
+		arena.defragment(256 * 1024);
+
+		// Show how many state calls reached the driver, once a second
+		gl_state.end_frame();
+		if (glfwGetTime() - stats_time >= 1.0)
+		{
+			const GLState::Stats& stats = gl_state.frame_stats();
+			const char* culling = !gpu_culling ? "CPU" : gpu_culler->count_draws() ? "GPU, count draw" : "GPU, 4.5 fallback";
+			std::string title = "Hello, World! | GL state calls: " + std::to_string(stats.issued) +
+				" issued, " + std::to_string(stats.filtered) + " filtered | culling: " + culling;
+			if (model_lod != ~0u)
+			{
+				title += " | model LOD " + std::to_string(model_lod);
+			}
+			glfwSetWindowTitle(win, title.c_str());
+			stats_time = glfwGetTime();
+		}
+
+		// Pick the grid cell under the cursor on click, clip space is world space so the ray
+		// goes straight into the screen
+		const bool clicked = glfwGetMouseButton(win, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+		if (clicked && !was_clicked)
+		{
+			double cursor_x, cursor_y;
+			int window_width, window_height;
+			glfwGetCursorPos(win, &cursor_x, &cursor_y);
+			glfwGetWindowSize(win, &window_width, &window_height);
+			if (window_width > 0 && window_height > 0)
+			{
+				const glm::vec3 origin((float)(cursor_x / window_width * 2.0 - 1.0),
+				                       (float)(1.0 - cursor_y / window_height * 2.0), 1.0f);
+				const Bvh::Hit hit = grid_bvh.raycast(origin, glm::vec3(0.0f, 0.0f, -1.0f));
+				if (hit.object != Bvh::no_object)
+				{
+					std::cout << "Info: picked grid cell " << hit.object % grid_size << ", " << hit.object / grid_size << std::endl;
+				}
+			}
+		}
+		was_clicked = clicked;
+
+		// Move the LOD camera by 2% of its distance per frame
+		if (glfwGetKey(win, GLFW_KEY_UP) == GLFW_PRESS)
+		{
+			lod_camera_z = model_center[2] + (lod_camera_z - model_center[2]) * 0.98f;
+		}
+		if (glfwGetKey(win, GLFW_KEY_DOWN) == GLFW_PRESS)
+		{
+			lod_camera_z = model_center[2] + (lod_camera_z - model_center[2]) * 1.02f;
+		}
+
+		const bool toggled = glfwGetKey(win, GLFW_KEY_C) == GLFW_PRESS;
+		if (toggled && !was_toggled && gpu_culler)
+		{
+			gpu_culling = !gpu_culling;
+		}
+		was_toggled = toggled;
 
 		// Check call events and swap buffers
 		glfwSwapBuffers(win);
 		glfwPollEvents(); // If any events are triggered, call corresponding callback functions
 	}
 
+	// GL objects have to go before the context does
+	if (gpu_culler)
+	{
+		gpu_culler->release();
+	}
+	instances.release();
+	arena.release();
+	model_vao.release();
+	model_vertices.release();
+	model_indices.release();
+
 	glfwDestroyWindow(win);
 	glfwTerminate();
 	return 0;
 }
 
+/**
+ * Open a cooked mesh. OBJ and glTF files are imported and cooked next to the source
+ * first, later runs load the .mesh as long as it is newer than the source.
+ */
+bool load_mesh(const std::string& path, MeshFile& mesh)
+{
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".mesh") == 0)
+	{
+		return mesh.open(path.c_str());
+	}
+
+	const std::string cooked = path + ".mesh";
+	std::error_code ec;
+	const bool stale = !std::filesystem::exists(cooked, ec) ||
+		std::filesystem::last_write_time(cooked, ec) < std::filesystem::last_write_time(path, ec);
+	if (stale)
+	{
+		ImportedMesh imported = import_mesh(path);
+		MeshCookOptions options;
+		options.generate_lods = true;
+		if (!imported.valid() ||
+			!MeshFile::cook(cooked.c_str(), imported.vertices.data(), imported.vertices.size(),
+			                imported.indices.data(), imported.indices.size(), options))
+		{
+			return false;
+		}
+	}
+	return mesh.open(cooked.c_str());
+}
+
+/**
+ * Pack the model's float position (location 0) and normal (location 1) into PackedVertex,
+ * 16 bytes per vertex. The normal doubles as the color, like the unpacked layout where it
+ * feeds aColor. Returns false if the file has no float positions, decode receives the
+ * bounds for uPositionOffset / uPositionScale.
+ */
+bool quantize_model(const MeshFile& model, Buffer& vertices, PositionQuantization& decode)
+{
+	const VertexAttribute* position = nullptr;
+	const VertexAttribute* normal = nullptr;
+	for (const VertexAttribute& attribute : model.attributes())
+	{
+		if (attribute.type == GL_FLOAT && attribute.size >= 3 && (attribute.location == 0 || attribute.location == 1))
+		{
+			(attribute.location == 0 ? position : normal) = &attribute;
+		}
+	}
+	if (!position)
+	{
+		return false;
+	}
+
+	const MeshFileHeader& header = model.header();
+	const char* vertex_data = model.stream(MeshStreamVertices).data();
+	std::vector<float> positions((size_t)header.vertex_count * 3);
+	std::vector<float> normals(normal ? positions.size() : 0);
+	for (size_t v = 0; v < header.vertex_count; v++)
+	{
+		const char* vertex = vertex_data + v * header.vertex_stride;
+		std::memcpy(&positions[v * 3], vertex + position->offset, 3 * sizeof(float));
+		if (normal)
+		{
+			std::memcpy(&normals[v * 3], vertex + normal->offset, 3 * sizeof(float));
+		}
+	}
+
+	const float* normal_data = normal ? normals.data() : nullptr;
+	const std::vector<PackedVertex> packed = quantize_vertices(positions.data(), normal_data, normal_data,
+	                                                           header.vertex_count, decode);
+	vertices = Buffer((GLsizeiptr)(packed.size() * sizeof(PackedVertex)), packed.data());
+	return true;
+}
+
 /**
  * glfw: process input in the GLFW window
  */
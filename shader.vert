@@ -1,9 +1,24 @@
-#version 460 core
+#version 450 core
+#include "vertex_decode.glsl"
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+#ifdef INSTANCED
+// Per instance, see InstanceData in Instancing.h
+layout (location = 4) in vec4 aModelRow0;
+layout (location = 5) in vec4 aModelRow1;
+layout (location = 6) in vec4 aModelRow2;
+layout (location = 7) in vec4 aParams;
+layout (location = 8) in vec4 aInstanceColor;
+#endif
 out vec3 ourColor;
 void main()
 {
-	gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
+	vec4 position = vec4(decode_position(aPos), 1.0); // Identity unless QUANTIZED_POSITION is defined
+#ifdef INSTANCED
+	gl_Position = vec4(dot(aModelRow0, position), dot(aModelRow1, position), dot(aModelRow2, position), 1.0);
+	ourColor = aColor * aInstanceColor.rgb;
+#else
+	gl_Position = position;
 	ourColor = aColor; // Set ourColor to the input color we got from the vertex data
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Decoding for the packed vertex formats written by VertexQuantize.h
+#ifdef QUANTIZED_POSITION
+// snorm16 positions are stored relative to the mesh bounds
+uniform vec3 uPositionOffset;
+uniform vec3 uPositionScale;
+vec3 decode_position(vec3 position)
+{
+	return uPositionOffset + uPositionScale * position;
+}
+#else
+vec3 decode_position(vec3 position)
+{
+	return position;
+}
+#endif
+
+// Octahedral encoded normal back to a unit vector
+vec3 oct_decode(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (normal.z < 0.0)
+	{
+		normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(normal);
+}